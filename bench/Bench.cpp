@@ -0,0 +1,475 @@
+#include <n2ajl/Parser.h>
+#include <n2ajl/Reclaimer.h>
+#include <n2ajl/Reformatter.h>
+#include <n2ajl/Serializer.h>
+#include <n2ajl/Tape.h>
+#include <n2ajl/Transcoder.h>
+#include <n2ajl/ThreadPool.h>
+#include "Corpus.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// every allocation in the process goes through here so each run can report allocations per document
+static size_t s_uAllocations = 0;
+
+void* operator new(size_t uSize)
+{
+	s_uAllocations++;
+
+	if (void* p = std::malloc(uSize ? uSize : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t uSize)
+{
+	return operator new(uSize);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+namespace n2ajl
+{
+namespace bench
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	size_t m_uScale = 4;
+	double m_dblMinSeconds = 0.5;
+	size_t m_uMinIterations = 3;
+	size_t m_uThreads = 0;
+	std::string m_szCorpusDirectory = N2AJL_BENCH_CORPUS_DIR;
+	std::string m_szFilter;
+	bool m_bGenerated = true;
+	bool m_bFiles = true;
+};
+
+struct Measurement
+{
+	double m_dblSeconds = 0.0;	// best iteration
+	size_t m_uAllocations = 0;	// allocations during the best iteration
+};
+
+static size_t GetPeakRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+
+	return pmc.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+#if defined(__APPLE__)
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// runs the operation until both the minimum time and iteration count are reached, keeps the fastest run
+template<typename Operation>
+static Measurement Measure(const Options& opt, Operation&& op)
+{
+	Measurement best;
+	best.m_dblSeconds = 1e300;
+
+	op(); // warm up
+
+	double dblTotal = 0.0;
+	for (size_t i = 0; i < opt.m_uMinIterations || dblTotal < opt.m_dblMinSeconds; i++)
+	{
+		size_t uAllocations = s_uAllocations;
+		auto start = Clock::now();
+
+		op();
+
+		double dblSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+		uAllocations = s_uAllocations - uAllocations;
+
+		if (dblSeconds < best.m_dblSeconds)
+		{
+			best.m_dblSeconds = dblSeconds;
+			best.m_uAllocations = uAllocations;
+		}
+
+		dblTotal += dblSeconds;
+	}
+
+	return best;
+}
+
+static size_t CountNodes(const Node& n)
+{
+	size_t uCount = 1;
+
+	if (n.GetType() == Node::Type::Object)
+		n.ForEachMember([&](const utf8nodestring&, const Node& member) { uCount += CountNodes(member); });
+	else if (n.GetType() == Node::Type::Array)
+		n.ForEachElement([&](const Node& element) { uCount += CountNodes(element); });
+
+	return uCount;
+}
+
+// every (object, label) pair in the tree, looked up again by the lookup benchmark
+static void CollectLookups(const Node& n, std::vector<std::pair<const Node*, utf8string>>& lookups)
+{
+	if (n.GetType() == Node::Type::Object)
+	{
+		std::vector<utf8string> labels;
+		n.ForEachMember([&](const utf8nodestring& szLabel, const Node&) { labels.emplace_back(szLabel.data(), szLabel.size()); });
+
+		for (const utf8string& szLabel : labels)
+		{
+			lookups.emplace_back(&n, szLabel);
+			CollectLookups(*n.Get(szLabel), lookups);
+		}
+	}
+	else if (n.GetType() == Node::Type::Array)
+	{
+		n.ForEachElement([&](const Node& element) { CollectLookups(element, lookups); });
+	}
+}
+
+static void Report(const CorpusDocument& doc, const char* szOperation, const Measurement& m, size_t uBytes, size_t uNodes, size_t uDocuments)
+{
+	char szThroughput[32] = "-";
+	if (uBytes)
+		snprintf(szThroughput, sizeof(szThroughput), "%.1f", (double)uBytes / (1024.0 * 1024.0) / m.m_dblSeconds);
+
+	printf("%-22s %-10s %10s %10.2f %12.1f %10.1f\n",
+		   doc.m_szName.c_str(),
+		   szOperation,
+		   szThroughput,
+		   m.m_dblSeconds * 1e9 / (double)(uNodes ? uNodes : 1),
+		   (double)m.m_uAllocations / (double)(uDocuments ? uDocuments : 1),
+		   (double)GetPeakRSS() / (1024.0 * 1024.0));
+
+	fflush(stdout);
+}
+
+static bool RunDocument(const Options& opt, const CorpusDocument& doc, ThreadPool& pool)
+{
+	ParserConfig parserCfg;
+	parserCfg.m_uMaxDepth = 256;
+
+	SerializerConfig serializerCfg;
+
+	// NDJSON is split up front, each line is a separate NUL terminated document
+	std::vector<utf8string> documents;
+	if (doc.m_bLines)
+	{
+		size_t uStart = 0;
+		while (uStart < doc.m_szJson.size())
+		{
+			size_t uEnd = doc.m_szJson.find('\n', uStart);
+			if (uEnd == utf8string::npos)
+				uEnd = doc.m_szJson.size();
+
+			if (uEnd > uStart)
+				documents.push_back(doc.m_szJson.substr(uStart, uEnd - uStart));
+
+			uStart = uEnd + 1;
+		}
+	}
+	else
+	{
+		documents.push_back(doc.m_szJson);
+	}
+
+	std::vector<Node> nodes(documents.size());
+	size_t uNodes = 0;
+
+	for (size_t i = 0; i < documents.size(); i++)
+	{
+		Result res = Parse(parserCfg, documents[i].c_str(), nodes[i]);
+		if (!res.m_bSuccess)
+		{
+			fprintf(stderr, "%s: document %zu failed to parse: %s\n", doc.m_szName.c_str(), i, res.GetMessage().c_str());
+			return false;
+		}
+
+		uNodes += CountNodes(nodes[i]);
+	}
+
+	size_t uBytes = doc.m_szJson.size();
+	size_t uOutputBytes = 0;
+	for (const Node& n : nodes)
+		uOutputBytes += Serialize(serializerCfg, n).size();
+
+	Measurement parse = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+		{
+			Node n;
+			Parse(parserCfg, documents[i].c_str(), n);
+		}
+	});
+	Report(doc, "parse", parse, uBytes, uNodes, documents.size());
+
+	// the same parses with the trees freed on another thread, the difference is what dropping costs
+	Reclaimer reclaimer;
+	Measurement retire = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+		{
+			Node n;
+			Parse(parserCfg, documents[i].c_str(), n);
+			reclaimer.Retire(std::move(n));
+		}
+	});
+	Report(doc, "retire", retire, uBytes, uNodes, documents.size());
+
+	// parses into the already built trees, which only overwrites values in place
+	ParserConfig reparseCfg = parserCfg;
+	reparseCfg.m_bReuseNodes = true;
+
+	std::vector<Node> reparsed = nodes;
+	Measurement reparse = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+			Parse(reparseCfg, documents[i].c_str(), reparsed[i]);
+	});
+	Report(doc, "reparse", reparse, uBytes, uNodes, documents.size());
+
+	Measurement validate = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+			Validate(parserCfg, documents[i].c_str(), documents[i].size());
+	});
+	Report(doc, "validate", validate, uBytes, uNodes, documents.size());
+
+	// a fresh document per parse, so allocations per document show its two buffers
+	Measurement tape = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+		{
+			TapeDocument parsed;
+			parsed.Parse(parserCfg, documents[i].c_str(), documents[i].size());
+		}
+	});
+	Report(doc, "tape", tape, uBytes, uNodes, documents.size());
+
+	Measurement serialize = Measure(opt, [&]()
+	{
+		for (const Node& n : nodes)
+			Serialize(serializerCfg, n);
+	});
+	Report(doc, "serialize", serialize, uOutputBytes, uNodes, documents.size());
+
+	// text to text with the serializer's layout, no tree in between
+	utf8string szReformatted;
+	Measurement reformat = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+			Reformat(parserCfg, serializerCfg, documents[i].c_str(), documents[i].size(), szReformatted);
+	});
+	Report(doc, "reformat", reformat, uBytes, uNodes, documents.size());
+
+	// JSON text straight to binary, MessagePack takes a counting pass first
+	utf8string szBinary;
+	Measurement msgpack = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+			JsonToBinary(BinaryFormat::MessagePack, parserCfg, documents[i].c_str(), documents[i].size(), szBinary);
+	});
+	Report(doc, "msgpack", msgpack, uBytes, uNodes, documents.size());
+
+	Measurement cbor = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+			JsonToBinary(BinaryFormat::CBOR, parserCfg, documents[i].c_str(), documents[i].size(), szBinary);
+	});
+	Report(doc, "cbor", cbor, uBytes, uNodes, documents.size());
+
+	SerializerConfig exactCfg = serializerCfg;
+	exactCfg.m_bExactSize = true;
+
+	Measurement exact = Measure(opt, [&]()
+	{
+		for (const Node& n : nodes)
+			Serialize(exactCfg, n);
+	});
+	Report(doc, "exact", exact, uOutputBytes, uNodes, documents.size());
+
+	// slices are only produced, copying them out is left to the consumer
+	GatherOutput gathered;
+	Measurement gather = Measure(opt, [&]()
+	{
+		for (const Node& n : nodes)
+			SerializeGather(serializerCfg, n, gathered);
+	});
+	Report(doc, "gather", gather, uOutputBytes, uNodes, documents.size());
+
+	Measurement parallel = Measure(opt, [&]()
+	{
+		for (const Node& n : nodes)
+			SerializeParallel(serializerCfg, n, pool);
+	});
+	Report(doc, "parallel", parallel, uOutputBytes, uNodes, documents.size());
+
+	Measurement roundtrip = Measure(opt, [&]()
+	{
+		for (size_t i = 0; i < documents.size(); i++)
+		{
+			Node n;
+			Parse(parserCfg, documents[i].c_str(), n);
+			Serialize(serializerCfg, n);
+		}
+	});
+	Report(doc, "roundtrip", roundtrip, uBytes, uNodes, documents.size());
+
+	// copies share storage, this measures the reference counting only
+	Measurement copy = Measure(opt, [&]()
+	{
+		for (const Node& n : nodes)
+		{
+			Node copied = n;
+			(void)copied;
+		}
+	});
+	Report(doc, "copy", copy, 0, uNodes, documents.size());
+
+	std::vector<std::pair<const Node*, utf8string>> lookups;
+	for (const Node& n : nodes)
+		CollectLookups(n, lookups);
+
+	size_t uFound = 0;
+	Measurement lookup = Measure(opt, [&]()
+	{
+		for (const auto& l : lookups)
+			uFound += l.first->Get(l.second) != nullptr;
+	});
+
+	// for lookups the per node figure is per lookup and throughput does not apply
+	Report(doc, "lookup", lookup, 0, lookups.size(), documents.size());
+
+	return uFound != 0 || lookups.empty();
+}
+
+static void PrintUsage()
+{
+	printf("usage: n2ajl_bench [options]\n"
+		   "  --scale N          multiplier for the generated corpus (default 4)\n"
+		   "  --min-time S       minimum seconds spent per measurement (default 0.5)\n"
+		   "  --iterations N     minimum iterations per measurement (default 3)\n"
+		   "  --threads N        worker threads for parallel operations (default: hardware threads)\n"
+		   "  --corpus DIR       directory of canonical corpus files\n"
+		   "  --filter NAME      only run documents whose name contains NAME\n"
+		   "  --generated-only   skip the canonical corpus files\n"
+		   "  --files-only       skip the generated corpus\n"
+		   "  --write-corpus DIR write the scale 1 generated corpus to DIR and exit\n");
+}
+
+}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace n2ajl::bench;
+
+	Options opt;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* szArg = argv[i];
+		const char* szValue = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (!strcmp(szArg, "--scale") && szValue)
+		{
+			opt.m_uScale = (size_t)strtoull(szValue, nullptr, 10);
+			i++;
+		}
+		else if (!strcmp(szArg, "--min-time") && szValue)
+		{
+			opt.m_dblMinSeconds = strtod(szValue, nullptr);
+			i++;
+		}
+		else if (!strcmp(szArg, "--iterations") && szValue)
+		{
+			opt.m_uMinIterations = (size_t)strtoull(szValue, nullptr, 10);
+			i++;
+		}
+		else if (!strcmp(szArg, "--threads") && szValue)
+		{
+			opt.m_uThreads = (size_t)strtoull(szValue, nullptr, 10);
+			i++;
+		}
+		else if (!strcmp(szArg, "--corpus") && szValue)
+		{
+			opt.m_szCorpusDirectory = szValue;
+			i++;
+		}
+		else if (!strcmp(szArg, "--filter") && szValue)
+		{
+			opt.m_szFilter = szValue;
+			i++;
+		}
+		else if (!strcmp(szArg, "--generated-only"))
+		{
+			opt.m_bFiles = false;
+		}
+		else if (!strcmp(szArg, "--files-only"))
+		{
+			opt.m_bGenerated = false;
+		}
+		else if (!strcmp(szArg, "--write-corpus") && szValue)
+		{
+			return WriteCorpus(szValue, GenerateCorpus(1)) ? 0 : 1;
+		}
+		else
+		{
+			PrintUsage();
+			return !strcmp(szArg, "--help") ? 0 : 1;
+		}
+	}
+
+	std::vector<CorpusDocument> corpus;
+
+	if (opt.m_bGenerated)
+		corpus = GenerateCorpus(opt.m_uScale ? opt.m_uScale : 1);
+
+	if (opt.m_bFiles)
+	{
+		for (CorpusDocument& doc : LoadCorpus(opt.m_szCorpusDirectory))
+			corpus.push_back(std::move(doc));
+	}
+
+	printf("%-22s %-10s %10s %10s %12s %10s\n", "document", "operation", "MB/s", "ns/node", "allocs/doc", "peak MB");
+
+	n2ajl::ThreadPool pool(opt.m_uThreads);
+
+	bool bOk = true;
+	for (const CorpusDocument& doc : corpus)
+	{
+		if (!opt.m_szFilter.empty() && doc.m_szName.find(opt.m_szFilter) == std::string::npos)
+			continue;
+
+		bOk &= RunDocument(opt, doc, pool);
+	}
+
+	return bOk ? 0 : 1;
+}
@@ -0,0 +1,360 @@
+#include "Corpus.h"
+#include <cstdio>
+#include <cstring>
+
+namespace n2ajl
+{
+namespace bench
+{
+
+// xorshift64*, used instead of <random> distributions so output is identical on every standard library
+class Random
+{
+public:
+	explicit Random(uint64_t uSeed) : m_uState(uSeed ? uSeed : 0x9E3779B97F4A7C15ull) {}
+
+	uint64_t Next()
+	{
+		m_uState ^= m_uState >> 12;
+		m_uState ^= m_uState << 25;
+		m_uState ^= m_uState >> 27;
+		return m_uState * 0x2545F4914F6CDD1Dull;
+	}
+
+	uint32_t Range(uint32_t uMax) { return (uint32_t)(Next() % uMax); }
+	bool Chance(uint32_t uPercent) { return Range(100) < uPercent; }
+
+private:
+	uint64_t m_uState;
+};
+
+static const char* s_Words[] =
+{
+	"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit", "sed", "do",
+	"eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore", "magna", "aliqua", "enim",
+	"caf\xC3\xA9", "na\xC3\xAFve", "\xE6\x97\xA5\xE6\x9C\xAC", "\xF0\x9F\x98\x80", "\\\"quoted\\\"", "line\\nbreak", "tab\\t", "\\u00e9t\\u00e9"
+};
+
+static void AppendWords(utf8string& out, Random& rng, size_t uCount)
+{
+	for (size_t i = 0; i < uCount; i++)
+	{
+		if (i)
+			out += ' ';
+
+		out += s_Words[rng.Range(sizeof(s_Words) / sizeof(*s_Words))];
+	}
+}
+
+// fixed point formatting from integers so no platform float formatting is involved
+static void AppendDecimal(utf8string& out, Random& rng, int iWhole, uint32_t uDigits)
+{
+	uint64_t uModulo = 1;
+	for (uint32_t i = 0; i < uDigits; i++)
+		uModulo *= 10;
+
+	char szBuf[64];
+	snprintf(szBuf, sizeof(szBuf), "%d.%0*llu", iWhole, (int)uDigits, (unsigned long long)(rng.Next() % uModulo));
+	out += szBuf;
+}
+
+static void AppendInteger(utf8string& out, uint64_t uValue)
+{
+	char szBuf[32];
+	snprintf(szBuf, sizeof(szBuf), "%llu", (unsigned long long)uValue);
+	out += szBuf;
+}
+
+utf8string GenerateNumbers(size_t uScale)
+{
+	Random rng(1);
+	utf8string out = R"({"type":"FeatureCollection","features":[)";
+
+	size_t uFeatures = uScale;
+	for (size_t f = 0; f < uFeatures; f++)
+	{
+		if (f)
+			out += ',';
+
+		out += R"({"type":"Feature","properties":{"name":"Region )";
+		AppendInteger(out, f);
+		out += R"("},"geometry":{"type":"Polygon","coordinates":[)";
+
+		size_t uRings = 8 + rng.Range(16);
+		for (size_t r = 0; r < uRings; r++)
+		{
+			if (r)
+				out += ',';
+
+			out += '[';
+
+			size_t uPoints = 200 + rng.Range(600);
+			for (size_t p = 0; p < uPoints; p++)
+			{
+				if (p)
+					out += ',';
+
+				out += '[';
+				AppendDecimal(out, rng, -140 + (int)rng.Range(90), 15);
+				out += ',';
+				AppendDecimal(out, rng, 42 + (int)rng.Range(40), 15);
+				out += ']';
+			}
+
+			out += ']';
+		}
+
+		out += "]}}";
+	}
+
+	out += "]}";
+	return out;
+}
+
+utf8string GenerateStrings(size_t uScale)
+{
+	Random rng(2);
+	utf8string out = R"({"statuses":[)";
+
+	size_t uStatuses = 200 * uScale;
+	for (size_t s = 0; s < uStatuses; s++)
+	{
+		if (s)
+			out += ',';
+
+		out += R"({"created_at":"Mon Sep 24 03:35:21 +0000 2012","id_str":")";
+		AppendInteger(out, 250075927172759552ull + rng.Range(1000000));
+		out += R"(","text":")";
+		AppendWords(out, rng, 8 + rng.Range(24));
+		out += R"(","source":"<a href=\"http://example.com\" rel=\"nofollow\">client</a>","truncated":false,"user":{"name":")";
+		AppendWords(out, rng, 2);
+		out += R"(","screen_name":"user_)";
+		AppendInteger(out, rng.Range(100000));
+		out += R"(","location":")";
+		AppendWords(out, rng, 1 + rng.Range(3));
+		out += R"(","description":")";
+		AppendWords(out, rng, rng.Range(40));
+		out += R"(","followers_count":)";
+		AppendInteger(out, rng.Range(50000));
+		out += R"(,"friends_count":)";
+		AppendInteger(out, rng.Range(5000));
+		out += R"(,"verified":)";
+		out += rng.Chance(5) ? "true" : "false";
+		out += R"(,"profile_image_url":"http://a0.example.com/profile_images/)";
+		AppendInteger(out, rng.Next() % 10000000);
+		out += R"(/avatar_normal.png"},"entities":{"hashtags":[)";
+
+		size_t uTags = rng.Range(4);
+		for (size_t t = 0; t < uTags; t++)
+		{
+			if (t)
+				out += ',';
+
+			out += R"({"text":")";
+			AppendWords(out, rng, 1);
+			out += R"(","indices":[)";
+			AppendInteger(out, t * 10);
+			out += ',';
+			AppendInteger(out, t * 10 + 8);
+			out += "]}";
+		}
+
+		out += R"(],"urls":[]},"retweet_count":)";
+		AppendInteger(out, rng.Range(1000));
+		out += R"(,"favorited":false,"retweeted":false,"lang":"en","in_reply_to_screen_name":null})";
+	}
+
+	out += R"(],"search_metadata":{"max_id_str":"250126199840518145","next_results":"?max_id=249279667666817023&q=%23freebandnames","query":"%23freebandnames","count":)";
+	AppendInteger(out, uStatuses);
+	out += "}}";
+	return out;
+}
+
+utf8string GenerateNested(size_t uScale)
+{
+	Random rng(3);
+	utf8string out = "[";
+
+	const size_t uDepth = 100;
+	size_t uChains = 4 * uScale;
+
+	for (size_t c = 0; c < uChains; c++)
+	{
+		if (c)
+			out += ',';
+
+		// alternate objects and single element arrays down to the maximum depth
+		for (size_t d = 0; d < uDepth; d++)
+		{
+			if (d % 2)
+			{
+				out += '[';
+			}
+			else
+			{
+				out += R"({"depth":)";
+				AppendInteger(out, d);
+				out += R"(,"id":")";
+				AppendInteger(out, rng.Next() % 100000);
+				out += R"(","flags":[true,false],"child":)";
+			}
+		}
+
+		out += R"({"leaf":true})";
+
+		for (size_t d = uDepth; d > 0; d--)
+			out += (d - 1) % 2 ? ']' : '}';
+	}
+
+	out += ']';
+	return out;
+}
+
+utf8string GenerateWide(size_t uScale)
+{
+	Random rng(4);
+	utf8string out = "{";
+
+	size_t uMembers = 5000 * uScale;
+	for (size_t m = 0; m < uMembers; m++)
+	{
+		char szKey[32];
+		snprintf(szKey, sizeof(szKey), "\"key_%08llx\":", (unsigned long long)(rng.Next() & 0xFFFFFFFF));
+
+		if (m)
+			out += ',';
+
+		out += szKey;
+
+		switch (m % 3)
+		{
+			case 0:
+				AppendInteger(out, rng.Range(1000000));
+				break;
+			case 1:
+				out += '"';
+				AppendWords(out, rng, 1 + rng.Range(4));
+				out += '"';
+				break;
+			default:
+				out += rng.Chance(50) ? "true" : "false";
+				break;
+		}
+	}
+
+	out += '}';
+	return out;
+}
+
+utf8string GenerateLines(size_t uScale)
+{
+	static const char* s_Levels[] = { "debug", "info", "info", "info", "warn", "error" };
+	static const char* s_Paths[] = { "/api/v1/users", "/api/v1/orders", "/health", "/api/v2/search", "/static/app.js" };
+
+	Random rng(5);
+	utf8string out;
+
+	size_t uLines = 2000 * uScale;
+	for (size_t l = 0; l < uLines; l++)
+	{
+		out += R"({"ts":)";
+		AppendInteger(out, 1700000000000ull + l * 13);
+		out += R"(,"level":")";
+		out += s_Levels[rng.Range(6)];
+		out += R"(","service":"gateway","path":")";
+		out += s_Paths[rng.Range(5)];
+		out += R"(","status":)";
+		AppendInteger(out, rng.Chance(95) ? 200 : 500 + rng.Range(4));
+		out += R"(,"latency_ms":)";
+		AppendDecimal(out, rng, (int)rng.Range(250), 3);
+		out += R"(,"msg":")";
+		AppendWords(out, rng, 3 + rng.Range(10));
+		out += R"(","tags":["edge",")";
+		out += rng.Chance(50) ? "eu-west" : "us-east";
+		out += R"("]})";
+		out += '\n';
+	}
+
+	return out;
+}
+
+std::vector<CorpusDocument> GenerateCorpus(size_t uScale)
+{
+	std::vector<CorpusDocument> corpus(5);
+
+	corpus[0].m_szName = "numbers";
+	corpus[0].m_szJson = GenerateNumbers(uScale);
+	corpus[1].m_szName = "strings";
+	corpus[1].m_szJson = GenerateStrings(uScale);
+	corpus[2].m_szName = "nested";
+	corpus[2].m_szJson = GenerateNested(uScale);
+	corpus[3].m_szName = "wide";
+	corpus[3].m_szJson = GenerateWide(uScale);
+	corpus[4].m_szName = "lines";
+	corpus[4].m_szJson = GenerateLines(uScale);
+	corpus[4].m_bLines = true;
+
+	return corpus;
+}
+
+// the canonical files, generated once at scale 1 and then frozen
+static const char* s_CorpusFiles[] = { "numbers.json", "strings.json", "nested.json", "wide.json", "lines.ndjson" };
+
+static bool ReadFile(const std::string& szPath, utf8string& out)
+{
+	FILE* f = fopen(szPath.c_str(), "rb");
+	if (!f)
+		return false;
+
+	char buf[65536];
+	size_t uRead;
+
+	out.clear();
+	while ((uRead = fread(buf, 1, sizeof(buf), f)) > 0)
+		out.append(buf, uRead);
+
+	fclose(f);
+	return true;
+}
+
+std::vector<CorpusDocument> LoadCorpus(const std::string& szDirectory)
+{
+	std::vector<CorpusDocument> corpus;
+
+	for (const char* szFile : s_CorpusFiles)
+	{
+		CorpusDocument doc;
+		if (!ReadFile(szDirectory + "/" + szFile, doc.m_szJson))
+			continue;
+
+		size_t uLength = strlen(szFile);
+		doc.m_bLines = uLength > 7 && strcmp(szFile + uLength - 7, ".ndjson") == 0;
+		doc.m_szName = std::string("file:") + szFile;
+		corpus.push_back(std::move(doc));
+	}
+
+	return corpus;
+}
+
+bool WriteCorpus(const std::string& szDirectory, const std::vector<CorpusDocument>& corpus)
+{
+	for (size_t i = 0; i < corpus.size() && i < sizeof(s_CorpusFiles) / sizeof(*s_CorpusFiles); i++)
+	{
+		std::string szPath = szDirectory + "/" + s_CorpusFiles[i];
+
+		FILE* f = fopen(szPath.c_str(), "wb");
+		if (!f)
+			return false;
+
+		bool bOk = fwrite(corpus[i].m_szJson.data(), 1, corpus[i].m_szJson.size(), f) == corpus[i].m_szJson.size();
+		fclose(f);
+
+		if (!bOk)
+			return false;
+	}
+
+	return true;
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <n2ajl/Node.h>
+
+namespace n2ajl
+{
+namespace bench
+{
+
+// one benchmark input, either a single document or newline delimited documents
+struct CorpusDocument
+{
+	std::string m_szName;
+	utf8string m_szJson;
+	bool m_bLines = false;	// NDJSON, every non-empty line is parsed as its own document
+};
+
+// deterministic generators, the same scale always produces the same bytes
+utf8string GenerateNumbers(size_t uScale);	// canada-like, polygons of coordinate pairs
+utf8string GenerateStrings(size_t uScale);	// twitter-like, statuses with long and escaped strings
+utf8string GenerateNested(size_t uScale);	// chains of deeply nested objects and arrays
+utf8string GenerateWide(size_t uScale);		// a single object with a very large number of members
+utf8string GenerateLines(size_t uScale);	// NDJSON log events
+
+std::vector<CorpusDocument> GenerateCorpus(size_t uScale);
+
+// canonical files checked in under bench/corpus
+std::vector<CorpusDocument> LoadCorpus(const std::string& szDirectory);
+bool WriteCorpus(const std::string& szDirectory, const std::vector<CorpusDocument>& corpus);
+
+}
+}
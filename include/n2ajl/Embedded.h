@@ -0,0 +1,838 @@
+#pragma once
+
+#if !N2AJL_CXX17
+#error "n2ajl/Embedded.h needs the C++17 build (N2AJL_CXX17)"
+#endif
+
+#include <cstdlib>
+#include <string_view>
+#include "Node.h"
+
+namespace n2ajl
+{
+
+template<size_t N>
+class EmbeddedDocument;
+
+template<typename Out>
+class EmbeddedParser;
+
+// one value of a document parsed at compile time, read like a const Node. strings and labels are views
+// into the embedded literal, escape sequences intact as in Node. the children of a span follow it in
+// the same table, next to each other, and object members are sorted by label
+class EmbeddedNode
+{
+public:
+	constexpr Node::Type GetType() const { return m_eType; }
+
+	constexpr bool GetBool() const { Check(Node::Type::Boolean); return m_bValue; }
+	constexpr double GetNumber() const { Check(Node::Type::Number); return m_dblValue; }
+	constexpr std::string_view GetString() const { Check(Node::Type::String); return m_szString; }
+
+	// object functions
+	constexpr const EmbeddedNode* Get(const Key& label) const
+	{
+		Check(Node::Type::Object);
+
+		std::string_view szLabel(label.GetData(), label.GetLength());
+		const EmbeddedNode* pMembers = this + m_uFirst;
+		size_t uLow = 0;
+		size_t uHigh = m_uCount;
+
+		while (uLow < uHigh)
+		{
+			size_t uMid = (uLow + uHigh) / 2;
+
+			if (pMembers[uMid].m_szLabel < szLabel)
+				uLow = uMid + 1;
+			else
+				uHigh = uMid;
+		}
+
+		return uLow < m_uCount && pMembers[uLow].m_szLabel == szLabel ? &pMembers[uLow] : nullptr;
+	}
+
+	constexpr bool GetOrDefault(const Key& label, bool bDefault) const
+	{
+		const EmbeddedNode* n = Get(label);
+		return n && n->m_eType == Node::Type::Boolean ? n->m_bValue : bDefault;
+	}
+
+	constexpr double GetOrDefault(const Key& label, double dblDefault) const
+	{
+		const EmbeddedNode* n = Get(label);
+		return n && n->m_eType == Node::Type::Number ? n->m_dblValue : dblDefault;
+	}
+
+	constexpr std::string_view GetOrDefault(const Key& label, std::string_view szDefault) const
+	{
+		const EmbeddedNode* n = Get(label);
+		return n && n->m_eType == Node::Type::String ? n->m_szString : szDefault;
+	}
+
+	constexpr size_t GetNumMembers() const { Check(Node::Type::Object); return m_uCount; }
+
+	// callback(std::string_view szLabel, const EmbeddedNode& member), in label order
+	template<typename Callback>
+	constexpr void ForEachMember(Callback&& callback) const
+	{
+		Check(Node::Type::Object);
+
+		for (uint32_t i = 0; i < m_uCount; i++)
+			callback(this[m_uFirst + i].m_szLabel, this[m_uFirst + i]);
+	}
+
+	// array functions
+	constexpr size_t Length() const { Check(Node::Type::Array); return m_uCount; }
+	constexpr const EmbeddedNode* At(size_t i) const { Check(Node::Type::Array); return this + m_uFirst + i; }
+	constexpr Node::Type GetElementType() const { Check(Node::Type::Array); return m_eElementType; }
+
+	template<typename Callback>
+	constexpr void ForEachElement(Callback&& callback) const
+	{
+		Check(Node::Type::Array);
+
+		for (uint32_t i = 0; i < m_uCount; i++)
+			callback(this[m_uFirst + i]);
+	}
+
+	// copies the value into a regular tree, for when it has to be changed or merged
+	Node ToNode(MemoryResource* pResource = nullptr) const;
+
+private:
+	template<size_t N>
+	friend class EmbeddedDocument;
+
+	template<typename Out>
+	friend class EmbeddedParser;
+
+	constexpr void Check(Node::Type eType) const
+	{
+		if (m_eType != eType)
+			std::abort();
+	}
+
+	Node::Type m_eType = Node::Type::Null;
+	Node::Type m_eElementType = Node::Type::Null;
+	bool m_bValue = false;
+	double m_dblValue = 0.0;
+	std::string_view m_szString;
+	std::string_view m_szLabel;		// as a member of an object
+	uint32_t m_uFirst = 0;			// children start this many entries further on
+	uint32_t m_uCount = 0;
+};
+
+// decimal to double as strtod rounds it for Parse (to nearest, ties to even), so an embedded number
+// equals the same text parsed at run time. up to 19 significant digits with a power of ten of at most
+// 22 are rounded once in double arithmetic, anything else is worked out exactly on big integers, which
+// costs a few thousand steps of constant evaluation per number
+class EmbeddedNumber
+{
+public:
+	// szInteger and szFraction hold nothing but digits, false when the value is beyond the range of a double
+	static constexpr bool ToDouble(std::string_view szInteger, std::string_view szFraction, int64_t iExponent, bool bNegative, double& dblValue)
+	{
+		size_t uTotal = szInteger.size() + szFraction.size();
+		auto Digit = [&](size_t i) { return (uint32_t)((i < szInteger.size() ? szInteger[i] : szFraction[i - szInteger.size()]) - '0'); };
+
+		// the significant digits are [uFirst, uLast], their value is scaled by 10^iExponent
+		size_t uFirst = 0;
+		size_t uLast = uTotal;
+
+		while (uFirst < uTotal && !Digit(uFirst))
+			uFirst++;
+
+		while (uLast > uFirst && !Digit(uLast - 1))
+			uLast--;
+
+		if (uFirst == uLast)
+		{
+			dblValue = bNegative ? -0.0 : 0.0;
+			return true;
+		}
+
+		iExponent += (int64_t)(uTotal - uLast) - (int64_t)szFraction.size();
+
+		// no double lies within a digit that far down, so the rest only matters for being non-zero; a
+		// trailing 1 stands in for it
+		bool bTruncated = uLast - uFirst > s_uMaxDigits;
+
+		if (bTruncated)
+		{
+			iExponent += (int64_t)(uLast - uFirst - s_uMaxDigits) - 1;
+			uLast = uFirst + s_uMaxDigits;
+		}
+
+		size_t uCount = uLast - uFirst + bTruncated;
+		int64_t iMagnitude = (int64_t)uCount + iExponent; // the value is below 10^iMagnitude
+
+		if (iMagnitude > 310)
+			return false;
+
+		if (iMagnitude < -324)
+		{
+			dblValue = bNegative ? -0.0 : 0.0; // below half the smallest subnormal
+			return true;
+		}
+
+		if (uCount <= 19 && iExponent >= -22 && iExponent <= 22)
+		{
+			uint64_t uMantissa = 0;
+
+			for (size_t i = uFirst; i < uLast; i++)
+				uMantissa = uMantissa * 10 + Digit(i);
+
+			if (uMantissa <= (1ull << 53))
+			{
+				// both operands are exact, so the one operation rounds correctly
+				double dblPower = 1.0;
+
+				for (int64_t i = 0; i < (iExponent < 0 ? -iExponent : iExponent); i++)
+					dblPower *= 10.0;
+
+				dblValue = iExponent < 0 ? (double)uMantissa / dblPower : (double)uMantissa * dblPower;
+				dblValue = bNegative ? -dblValue : dblValue;
+				return true;
+			}
+		}
+
+		BigInt value;
+
+		for (size_t i = uFirst; i < uLast;)
+		{
+			uint32_t uChunk = 0;
+			uint32_t uScale = 1;
+
+			for (; i < uLast && uScale < 1000000000; i++, uScale *= 10)
+				uChunk = uChunk * 10 + Digit(i);
+
+			value.MulAdd(uScale, uChunk);
+		}
+
+		if (bTruncated)
+			value.MulAdd(10, 1);
+
+		// 64 bits of the binary value with its exponent, bSticky when anything below them is non-zero
+		uint64_t uBits = 0;
+		int64_t iBinary = 0;
+		bool bSticky = false;
+
+		if (iExponent >= 0)
+		{
+			value.MulPow5((size_t)iExponent);
+			iBinary = iExponent + (int64_t)value.Top64(uBits, bSticky);
+		}
+		else
+		{
+			BigInt divisor;
+			divisor.MulAdd(1, 1);
+			divisor.MulPow5((size_t)-iExponent);
+
+			// line the quotient up with 64 bits, it then lies in [2^62, 2^64)
+			int64_t iShift = (int64_t)divisor.Bits() + 63 - (int64_t)value.Bits();
+
+			if (iShift >= 0)
+				value.ShiftLeft((size_t)iShift);
+			else
+				divisor.ShiftLeft((size_t)-iShift);
+
+			iBinary = iExponent - iShift;
+			divisor.ShiftLeft(63);
+
+			for (int i = 63; i >= 0; i--)
+			{
+				if (!value.Less(divisor))
+				{
+					value.Sub(divisor);
+					uBits |= 1ull << i;
+				}
+
+				divisor.ShiftRight1();
+			}
+
+			bSticky = !value.IsZero();
+		}
+
+		if (!Round(uBits, iBinary, bSticky, dblValue))
+			return false;
+
+		dblValue = bNegative ? -dblValue : dblValue;
+		return true;
+	}
+
+private:
+	static constexpr size_t s_uMaxDigits = 800;
+
+	// little endian 32 bit limbs, the ones past m_uSize are always zero
+	struct BigInt
+	{
+		// 801 digits shifted up by 64 bits, or 5^1125 shifted as far
+		static constexpr size_t s_uLimbs = 96;
+
+		uint32_t m_vLimbs[s_uLimbs] = {};
+		size_t m_uSize = 0;
+
+		constexpr bool IsZero() const { return !m_uSize; }
+
+		constexpr size_t Bits() const
+		{
+			if (!m_uSize)
+				return 0;
+
+			size_t uBits = m_uSize * 32;
+
+			for (uint32_t uTop = m_vLimbs[m_uSize - 1]; !(uTop & 0x80000000u); uTop <<= 1)
+				uBits--;
+
+			return uBits;
+		}
+
+		constexpr void Trim()
+		{
+			while (m_uSize && !m_vLimbs[m_uSize - 1])
+				m_uSize--;
+		}
+
+		// this * uMul + uAdd
+		constexpr void MulAdd(uint32_t uMul, uint32_t uAdd)
+		{
+			uint64_t uCarry = uAdd;
+
+			for (size_t i = 0; i < m_uSize; i++)
+			{
+				uint64_t u = (uint64_t)m_vLimbs[i] * uMul + uCarry;
+				m_vLimbs[i] = (uint32_t)u;
+				uCarry = u >> 32;
+			}
+
+			if (uCarry)
+				m_vLimbs[m_uSize++] = (uint32_t)uCarry;
+		}
+
+		constexpr void MulPow5(size_t uPower)
+		{
+			for (; uPower >= 13; uPower -= 13)
+				MulAdd(1220703125u, 0); // 5^13
+
+			uint32_t uRest = 1;
+
+			for (; uPower; uPower--)
+				uRest *= 5;
+
+			MulAdd(uRest, 0);
+		}
+
+		constexpr void ShiftLeft(size_t uBits)
+		{
+			if (!m_uSize)
+				return;
+
+			size_t uLimbs = uBits / 32;
+			size_t uShift = uBits % 32;
+
+			for (size_t i = m_uSize; i-- > 0;)
+			{
+				uint64_t u = (uint64_t)m_vLimbs[i] << uShift;
+				m_vLimbs[i + uLimbs + 1] |= (uint32_t)(u >> 32);
+				m_vLimbs[i + uLimbs] = (uint32_t)u;
+			}
+
+			for (size_t i = 0; i < uLimbs; i++)
+				m_vLimbs[i] = 0;
+
+			m_uSize += uLimbs + 1;
+			Trim();
+		}
+
+		constexpr void ShiftRight1()
+		{
+			for (size_t i = 0; i < m_uSize; i++)
+				m_vLimbs[i] = (m_vLimbs[i] >> 1) | (m_vLimbs[i + 1] << 31);
+
+			Trim();
+		}
+
+		constexpr bool Less(const BigInt& other) const
+		{
+			if (m_uSize != other.m_uSize)
+				return m_uSize < other.m_uSize;
+
+			for (size_t i = m_uSize; i-- > 0;)
+			{
+				if (m_vLimbs[i] != other.m_vLimbs[i])
+					return m_vLimbs[i] < other.m_vLimbs[i];
+			}
+
+			return false;
+		}
+
+		// this - other, other is not larger
+		constexpr void Sub(const BigInt& other)
+		{
+			uint64_t uBorrow = 0;
+
+			for (size_t i = 0; i < m_uSize; i++)
+			{
+				uint64_t u = (uint64_t)m_vLimbs[i] - (i < other.m_uSize ? other.m_vLimbs[i] : 0) - uBorrow;
+				m_vLimbs[i] = (uint32_t)u;
+				uBorrow = (u >> 32) & 1;
+			}
+
+			Trim();
+		}
+
+		// the highest 64 bits (or all of them), returns how many bits are below them
+		constexpr size_t Top64(uint64_t& uTop, bool& bSticky) const
+		{
+			size_t uBits = Bits();
+			size_t uBelow = uBits > 64 ? uBits - 64 : 0;
+
+			uTop = 0;
+
+			for (size_t i = uBits; i-- > uBelow;)
+				uTop = (uTop << 1) | ((m_vLimbs[i / 32] >> (i % 32)) & 1);
+
+			bSticky = false;
+
+			for (size_t i = 0; i < uBelow / 32; i++)
+				bSticky |= m_vLimbs[i] != 0;
+
+			if (uBelow % 32)
+				bSticky |= (m_vLimbs[uBelow / 32] & ((1u << (uBelow % 32)) - 1)) != 0;
+
+			return uBelow;
+		}
+	};
+
+	// uBits * 2^iBinary, plus something below the last bit when bSticky, to the nearest double
+	static constexpr bool Round(uint64_t uBits, int64_t iBinary, bool bSticky, double& dblValue)
+	{
+		int64_t iTop = iBinary + 63;
+
+		while (!(uBits >> 63))
+		{
+			uBits <<= 1; // the bits shifted in below are zero, the sticky part stays below them
+			iBinary--;
+			iTop--;
+		}
+
+		if (iTop > 1023)
+			return false;
+
+		// the lowest bit a double keeps at this magnitude, subnormals keep fewer
+		int64_t iLow = iTop - 52 > -1074 ? iTop - 52 : -1074;
+		int64_t iDrop = iLow - iBinary;
+		uint64_t uMantissa = 0;
+
+		if (iDrop <= 64)
+		{
+			uMantissa = iDrop == 64 ? 0 : uBits >> iDrop;
+
+			bool bHalf = (uBits >> (iDrop - 1)) & 1;
+			bool bRest = bSticky || (iDrop > 1 && (uBits << (65 - iDrop)) != 0);
+
+			if (bHalf && (bRest || (uMantissa & 1)))
+				uMantissa++;
+		}
+
+		if ((uMantissa >> 53) && iLow + 53 > 1023)
+			return false;
+
+		// both factors are exact and so is their product
+		double dblScale = 1.0;
+		double dblBase = iLow < 0 ? 0.5 : 2.0;
+
+		for (int64_t iPower = iLow < 0 ? -iLow : iLow; iPower; iPower >>= 1)
+		{
+			if (iPower & 1)
+				dblScale *= dblBase;
+
+			if (iPower > 1)
+				dblBase *= dblBase;
+		}
+
+		dblValue = (double)uMantissa * dblScale;
+		return true;
+	}
+};
+
+// strict JSON with Parse's own restrictions (a span at the root, arrays of a single type, no empty
+// labels), nothing but whitespace may follow the root. Out receives every value in document order
+template<typename Out>
+class EmbeddedParser
+{
+public:
+	constexpr EmbeddedParser(std::string_view szJson, Out& out) : m_szJson(szJson), m_Out(out) {}
+
+	constexpr bool Document()
+	{
+		if (m_szJson.substr(0, 3) == "\xEF\xBB\xBF")
+			m_uPos = 3;
+
+		SkipWhitespace();
+
+		if (Peek() != '{' && Peek() != '[')
+			return false;
+
+		Node::Type eRoot = Node::Type::Null;
+
+		if (!Span(std::string_view(), eRoot))
+			return false;
+
+		SkipWhitespace();
+		return m_uPos == m_szJson.size();
+	}
+
+private:
+	constexpr char Peek() const { return m_uPos < m_szJson.size() ? m_szJson[m_uPos] : '\0'; }
+
+	constexpr void SkipWhitespace()
+	{
+		while (Peek() == ' ' || Peek() == '\t' || Peek() == '\n' || Peek() == '\r')
+			m_uPos++;
+	}
+
+	constexpr bool Span(std::string_view szLabel, Node::Type& eType)
+	{
+		bool bObject = m_szJson[m_uPos++] == '{';
+		size_t uIndex = m_Out.Begin(szLabel, bObject);
+		uint32_t uCount = 0;
+		Node::Type eElement = Node::Type::Null;
+
+		eType = bObject ? Node::Type::Object : Node::Type::Array;
+		SkipWhitespace();
+
+		if (Peek() == (bObject ? '}' : ']'))
+		{
+			m_uPos++;
+			m_Out.End(uIndex, 0, eElement);
+			return true;
+		}
+
+		for (;;)
+		{
+			std::string_view szMember;
+
+			SkipWhitespace();
+
+			if (bObject)
+			{
+				if (!String(szMember) || szMember.empty())
+					return false;
+
+				SkipWhitespace();
+
+				if (Peek() != ':')
+					return false;
+
+				m_uPos++;
+				SkipWhitespace();
+			}
+
+			Node::Type eValue = Node::Type::Null;
+
+			if (!Value(szMember, eValue))
+				return false;
+
+			if (!bObject && uCount && eValue != eElement)
+				return false;
+
+			eElement = eValue;
+			uCount++;
+
+			SkipWhitespace();
+
+			if (Peek() == ',')
+			{
+				m_uPos++;
+				continue;
+			}
+
+			if (Peek() != (bObject ? '}' : ']'))
+				return false;
+
+			m_uPos++;
+			m_Out.End(uIndex, uCount, bObject ? Node::Type::Null : eElement);
+			return true;
+		}
+	}
+
+	constexpr bool Value(std::string_view szLabel, Node::Type& eType)
+	{
+		char ch = Peek();
+
+		if (ch == '{' || ch == '[')
+			return Span(szLabel, eType);
+
+		EmbeddedNode value;
+		value.m_szLabel = szLabel;
+
+		if (ch == '\"')
+		{
+			if (!String(value.m_szString))
+				return false;
+
+			value.m_eType = Node::Type::String;
+		}
+		else if (Literal("true") || Literal("false"))
+		{
+			value.m_eType = Node::Type::Boolean;
+			value.m_bValue = ch == 't';
+		}
+		else if (Literal("null"))
+		{
+			value.m_eType = Node::Type::Null;
+		}
+		else if (Number(value.m_dblValue))
+		{
+			value.m_eType = Node::Type::Number;
+		}
+		else
+		{
+			return false;
+		}
+
+		eType = value.m_eType;
+		m_Out.Scalar(value);
+		return true;
+	}
+
+	// the contents between the quotes, a backslash takes whatever follows it like Parse does
+	constexpr bool String(std::string_view& szValue)
+	{
+		if (Peek() != '\"')
+			return false;
+
+		size_t uStart = ++m_uPos;
+
+		for (; m_uPos < m_szJson.size(); m_uPos++)
+		{
+			if (m_szJson[m_uPos] == '\\')
+			{
+				m_uPos++;
+				continue;
+			}
+
+			if (m_szJson[m_uPos] == '\"')
+			{
+				szValue = m_szJson.substr(uStart, m_uPos - uStart);
+				m_uPos++;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	constexpr bool Literal(std::string_view szLiteral)
+	{
+		if (m_szJson.substr(m_uPos, szLiteral.size()) != szLiteral)
+			return false;
+
+		m_uPos += szLiteral.size();
+		return true;
+	}
+
+	static constexpr bool IsDigit(char ch) { return ch >= '0' && ch <= '9'; }
+
+	// the JSON number grammar, the digits are handed to EmbeddedNumber as they are written
+	constexpr bool Number(double& dblValue)
+	{
+		bool bNegative = Peek() == '-';
+
+		if (bNegative)
+			m_uPos++;
+
+		if (!IsDigit(Peek()))
+			return false;
+
+		if (Peek() == '0' && m_uPos + 1 < m_szJson.size() && IsDigit(m_szJson[m_uPos + 1]))
+			return false; // leading zero
+
+		size_t uStart = m_uPos;
+
+		while (IsDigit(Peek()))
+			m_uPos++;
+
+		std::string_view szInteger = m_szJson.substr(uStart, m_uPos - uStart);
+		std::string_view szFraction;
+
+		if (Peek() == '.')
+		{
+			uStart = ++m_uPos;
+
+			if (!IsDigit(Peek()))
+				return false;
+
+			while (IsDigit(Peek()))
+				m_uPos++;
+
+			szFraction = m_szJson.substr(uStart, m_uPos - uStart);
+		}
+
+		int64_t iExponent = 0;
+
+		if (Peek() == 'e' || Peek() == 'E')
+		{
+			m_uPos++;
+
+			bool bNegativeExponent = Peek() == '-';
+
+			if (Peek() == '+' || Peek() == '-')
+				m_uPos++;
+
+			if (!IsDigit(Peek()))
+				return false;
+
+			while (IsDigit(Peek()))
+			{
+				if (iExponent < 100000)
+					iExponent = iExponent * 10 + (Peek() - '0');
+
+				m_uPos++;
+			}
+
+			iExponent = bNegativeExponent ? -iExponent : iExponent;
+		}
+
+		return EmbeddedNumber::ToDouble(szInteger, szFraction, iExponent, bNegative, dblValue);
+	}
+
+	std::string_view m_szJson;
+	size_t m_uPos = 0;
+	Out& m_Out;
+};
+
+// only counts values, the first pass that sizes the table
+struct EmbeddedCounter
+{
+	constexpr size_t Begin(std::string_view, bool) { return m_uNodes++; }
+	constexpr void End(size_t, uint32_t, Node::Type) {}
+	constexpr void Scalar(const EmbeddedNode&) { m_uNodes++; }
+
+	size_t m_uNodes = 0;
+};
+
+// the number of values in szJson, 0 if it is malformed
+constexpr size_t CountEmbedded(std::string_view szJson)
+{
+	EmbeddedCounter counter;
+	EmbeddedParser<EmbeddedCounter> parser(szJson, counter);
+
+	return parser.Document() ? counter.m_uNodes : 0;
+}
+
+template<size_t N>
+class EmbeddedDocument
+{
+public:
+	constexpr explicit EmbeddedDocument(std::string_view szJson)
+	{
+		// values are collected in document order first, with m_uFirst holding the size of their subtree
+		Preorder preorder;
+		EmbeddedParser<Preorder> parser(szJson, preorder);
+		m_bValid = parser.Document() && preorder.m_uNodes == N;
+
+		// then laid out breadth first, which puts the children of every span next to each other
+		uint32_t vSource[N] = {};
+		uint32_t uPlaced = 1;
+
+		for (uint32_t i = 0; i < N && m_bValid; i++)
+		{
+			EmbeddedNode entry = preorder.m_Nodes[vSource[i]];
+
+			if (entry.m_eType != Node::Type::Object && entry.m_eType != Node::Type::Array)
+			{
+				entry.m_uFirst = 0;
+				m_Nodes[i] = entry;
+				continue;
+			}
+
+			uint32_t uFirst = uPlaced;
+			uint32_t uChild = vSource[i] + 1;
+
+			for (uint32_t c = 0; c < entry.m_uCount; c++)
+			{
+				vSource[uPlaced++] = uChild;
+				uChild += preorder.m_Nodes[uChild].m_uFirst;
+			}
+
+			// insertion sort, objects in embedded documents are small
+			for (uint32_t a = uFirst + 1; entry.m_eType == Node::Type::Object && a < uPlaced; a++)
+			{
+				for (uint32_t b = a; b > uFirst && preorder.m_Nodes[vSource[b]].m_szLabel < preorder.m_Nodes[vSource[b - 1]].m_szLabel; b--)
+				{
+					uint32_t uSwap = vSource[b];
+					vSource[b] = vSource[b - 1];
+					vSource[b - 1] = uSwap;
+				}
+			}
+
+			for (uint32_t a = uFirst + 1; entry.m_eType == Node::Type::Object && a < uPlaced; a++)
+			{
+				if (preorder.m_Nodes[vSource[a]].m_szLabel == preorder.m_Nodes[vSource[a - 1]].m_szLabel)
+					m_bValid = false;
+			}
+
+			entry.m_uFirst = uFirst - i;
+			m_Nodes[i] = entry;
+		}
+	}
+
+	constexpr const EmbeddedNode& GetRoot() const { return m_Nodes[0]; }
+
+	// false when an object repeats a label, which Parse would resolve by keeping the last one
+	constexpr bool IsValid() const { return m_bValid; }
+
+private:
+	struct Preorder
+	{
+		constexpr size_t Begin(std::string_view szLabel, bool bObject)
+		{
+			EmbeddedNode& entry = m_Nodes[m_uNodes];
+			entry.m_eType = bObject ? Node::Type::Object : Node::Type::Array;
+			entry.m_szLabel = szLabel;
+
+			return m_uNodes++;
+		}
+
+		constexpr void End(size_t uIndex, uint32_t uCount, Node::Type eElement)
+		{
+			m_Nodes[uIndex].m_uCount = uCount;
+			m_Nodes[uIndex].m_eElementType = eElement;
+			m_Nodes[uIndex].m_uFirst = (uint32_t)(m_uNodes - uIndex);
+		}
+
+		constexpr void Scalar(const EmbeddedNode& value)
+		{
+			m_Nodes[m_uNodes] = value;
+			m_Nodes[m_uNodes++].m_uFirst = 1;
+		}
+
+		EmbeddedNode m_Nodes[N] = {};
+		size_t m_uNodes = 0;
+	};
+
+	EmbeddedNode m_Nodes[N] = {};
+	bool m_bValid = false;
+};
+
+// parses szJson (a lambda returning it, see N2AJL_EMBED) while compiling; malformed JSON fails the build
+template<typename Source>
+constexpr auto EmbedJson(Source source)
+{
+	constexpr std::string_view szJson = source();
+	constexpr size_t uNodes = CountEmbedded(szJson);
+	static_assert(uNodes != 0, "n2ajl: embedded JSON is malformed");
+
+	constexpr EmbeddedDocument<uNodes ? uNodes : 1> document(uNodes ? szJson : std::string_view("[]"));
+	static_assert(document.IsValid(), "n2ajl: embedded JSON repeats a label within an object");
+
+	return document;
+}
+
+}
+
+// static constexpr auto s_Defaults = N2AJL_EMBED(R"({"port": 8080})");
+// s_Defaults.GetRoot().Get("port")->GetNumber() is read from the table, nothing is parsed at run time
+#define N2AJL_EMBED(szJson) ::n2ajl::EmbedJson([]() constexpr { return std::string_view(szJson); })
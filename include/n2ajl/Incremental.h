@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Parser.h"
+
+namespace n2ajl
+{
+
+struct SourceSpan;
+
+// a parsed document that keeps its text and where every value lies in it, so an edit reparses only the
+// smallest value or span enclosing it. members and elements of that span the edit did not reach keep
+// their nodes and are stepped over, not read again: an edit costs about its own size plus the member
+// or element count of the span it falls in, rather than the size of the document
+class IncrementalDocument
+{
+public:
+	IncrementalDocument();
+	~IncrementalDocument();
+
+	// parses the text like Parse and keeps a copy of it; only m_uMaxDepth and m_bComputeHashes of cfg
+	// are used. Result::m_pSource points into the copy, which the next call changes
+	Result Parse(const ParserConfig& cfg, const utf8_t* pJson, size_t uLength, MemoryResource* pResource = nullptr);
+
+	// replaces uRemoved bytes at uOffset (both clamped to the text) with uInserted bytes from pInserted.
+	// the tree and the result are what Parse gives for the edited text. an edit that leaves the text
+	// invalid costs a pass over it to find the error (without building anything) and an empty tree,
+	// the nodes are kept so the edit that repairs it again only rebuilds what changed in between
+	Result Edit(size_t uOffset, size_t uRemoved, const utf8_t* pInserted, size_t uInserted);
+
+	const Node& GetRoot() const;
+	const std::string& GetText() const { return m_szText; }
+
+private:
+	struct PathStep
+	{
+		SourceSpan* m_pSpan;
+		size_t m_uStart;	// in the text before the edit
+		size_t m_uIndex;	// among the members or elements of the previous step
+	};
+
+	Result Reparse();
+	bool Rebuild(const std::vector<PathStep>& vPath, size_t uOffset, size_t uRemoved, size_t uInserted);
+	std::string GetOldText(size_t uAt, size_t uLength) const;	// positions and bytes from before the edit
+	Node* FindNode(const std::vector<PathStep>& vPath, size_t uSteps);
+
+	ParserConfig m_Config;
+	MemoryResource* m_pResource = nullptr;
+	std::string m_szText;
+	std::string m_szScratch;
+
+	// the spans and tree of the last text that parsed. edits are measured against it: while the text does
+	// not parse m_bDirty is set and the edits made since are kept merged into one
+	Node m_Root;
+	std::unique_ptr<SourceSpan> m_pSpans;
+	bool m_bDirty = false;
+	std::string m_szDirtyText;	// the bytes of the last valid text the edits replace
+	size_t m_uDirtyOffset = 0;
+	size_t m_uDirtyRemoved = 0;
+	size_t m_uDirtyInserted = 0;
+};
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Node.h"
+#include "Parser.h"
+#include "ThreadPool.h"
+
+namespace n2ajl
+{
+
+struct IngestConfig
+{
+	ParserConfig m_Parser;			// m_pStats is ignored, files are parsed concurrently
+
+	// files between the start of their read and their delivery, each holds one buffer; reading stops
+	// while all are taken, so memory stays bounded however far the parse falls behind
+	size_t m_uBuffers = 4;
+
+	// deliver in the order of vPaths, otherwise as soon as each file is parsed
+	bool m_bOrdered = true;
+};
+
+// called on the thread that called IngestFiles. result.m_pSource points into the file's buffer, which
+// is recycled once the callback returns; a file that cannot be read fails with ErrorCode::ReadFailed
+using IngestCallback = std::function<void(size_t uIndex, const Result& result, Node& json)>;
+
+// reads and parses every file on pool, the read of one file overlapping the parse of others, and
+// returns once all were delivered. safe to call from a pool thread, waiting runs queued tasks
+void IngestFiles(ThreadPool& pool, const IngestConfig& cfg, const std::vector<std::string>& vPaths, const IngestCallback& onFile);
+
+}
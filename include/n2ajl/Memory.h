@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#if N2AJL_CXX17
+#include <memory_resource>
+#endif
+
+namespace n2ajl
+{
+
+#if N2AJL_CXX17
+
+// in C++17 builds any std::pmr resource (pools, monotonic buffers) can be handed to n2ajl directly
+using MemoryResource = std::pmr::memory_resource;
+
+#else
+
+// mirrors std::pmr::memory_resource, resources written against this compile unchanged in C++17 builds
+class MemoryResource
+{
+public:
+	virtual ~MemoryResource() = default;
+
+	void* allocate(size_t uBytes, size_t uAlignment = alignof(std::max_align_t)) { return do_allocate(uBytes, uAlignment); }
+	void deallocate(void* p, size_t uBytes, size_t uAlignment = alignof(std::max_align_t)) { do_deallocate(p, uBytes, uAlignment); }
+	bool is_equal(const MemoryResource& other) const noexcept { return this == &other || do_is_equal(other); }
+
+protected:
+	virtual void* do_allocate(size_t uBytes, size_t uAlignment) = 0;
+	virtual void do_deallocate(void* p, size_t uBytes, size_t uAlignment) = 0;
+	virtual bool do_is_equal(const MemoryResource& other) const noexcept = 0;
+};
+
+#endif
+
+// operator new/delete, the default unless changed with SetDefaultResource
+MemoryResource* GetNewDeleteResource();
+
+MemoryResource* GetDefaultResource();
+MemoryResource* SetDefaultResource(MemoryResource* pResource); // returns the previous default
+
+// allocates from a MemoryResource, unlike std::pmr::polymorphic_allocator the resource follows copies
+// so a copied subtree stays in the arena its source was built in
+template<typename T>
+class Allocator
+{
+public:
+	using value_type = T;
+
+	using propagate_on_container_copy_assignment = std::false_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	Allocator() noexcept : m_pResource(GetDefaultResource()) {}
+	Allocator(MemoryResource* pResource) noexcept : m_pResource(pResource ? pResource : GetDefaultResource()) {}
+
+	template<typename U>
+	Allocator(const Allocator<U>& other) noexcept : m_pResource(other.GetResource()) {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(m_pResource->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		m_pResource->deallocate(p, n * sizeof(T), alignof(T));
+	}
+
+	Allocator select_on_container_copy_construction() const { return *this; }
+
+	MemoryResource* GetResource() const { return m_pResource; }
+
+private:
+	MemoryResource* m_pResource;
+};
+
+template<typename T, typename U>
+inline bool operator==(const Allocator<T>& a, const Allocator<U>& b)
+{
+	return a.GetResource() == b.GetResource() || a.GetResource()->is_equal(*b.GetResource());
+}
+
+template<typename T, typename U>
+inline bool operator!=(const Allocator<T>& a, const Allocator<U>& b)
+{
+	return !(a == b);
+}
+
+// bump allocator over chunks taken from an upstream resource, deallocate is a no-op
+// and everything is returned at once by Release or destruction; not thread safe
+class ArenaResource : public MemoryResource
+{
+public:
+	explicit ArenaResource(size_t uChunkSize = 64 * 1024, MemoryResource* pUpstream = nullptr);
+	~ArenaResource() override;
+
+	ArenaResource(const ArenaResource&) = delete;
+	ArenaResource& operator=(const ArenaResource&) = delete;
+
+	void Release();		// frees all chunks, keeps the first one for reuse
+	size_t GetNumBytesAllocated() const { return m_uAllocated; }
+
+protected:
+	void* do_allocate(size_t uBytes, size_t uAlignment) override;
+	void do_deallocate(void* p, size_t uBytes, size_t uAlignment) override;
+	bool do_is_equal(const MemoryResource& other) const noexcept override;
+
+private:
+	struct Chunk
+	{
+		Chunk* m_pNext;
+		size_t m_uSize;
+	};
+
+	MemoryResource* m_pUpstream;
+	Chunk* m_pChunks = nullptr;
+	char* m_pCursor = nullptr;
+	char* m_pEnd = nullptr;
+	size_t m_uChunkSize;
+	size_t m_uAllocated = 0;
+};
+
+}
@@ -4,15 +4,107 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <atomic>
 #include "UTF.h"
+#include "Memory.h"
 
 namespace n2ajl
 {
 
+// std::string, what the API takes and returns apart from the strings stored in a tree
 using utf8string = std::basic_string<utf8_t>;
 
+// the string values and member labels a tree holds (GetString, ForEachMember, members), allocated from
+// the resource the tree was built with. being a different type, it does not bind to a utf8string
+// reference: copy with utf8string(s.data(), s.size()), or take it as const utf8nodestring&
+using utf8nodestring = std::basic_string<utf8_t, std::char_traits<utf8_t>, Allocator<utf8_t>>;
+
+// a member label to look up, which is not copied and must outlive the call. its FNV-1a hash is taken
+// on construction, at compile time for a constexpr Key ("constexpr Key s_Id("id");"), and is what
+// objects with many members probe their index with
+class Key
+{
+public:
+	constexpr Key(const utf8_t* szLabel) : Key(szLabel, Length(szLabel)) {}
+	constexpr Key(const utf8_t* pLabel, size_t uLength) : m_pData(pLabel), m_uLength(uLength), m_uHash(HashLabel(pLabel, uLength)) {}
+	template<typename Alloc>
+	Key(const std::basic_string<utf8_t, std::char_traits<utf8_t>, Alloc>& szLabel) : Key(szLabel.data(), szLabel.size()) {}
+
+	constexpr const utf8_t* GetData() const { return m_pData; }
+	constexpr size_t GetLength() const { return m_uLength; }
+	constexpr uint64_t GetHash() const { return m_uHash; }
+
+	static constexpr uint64_t HashLabel(const utf8_t* pLabel, size_t uLength)
+	{
+		uint64_t h = 0xCBF29CE484222325ull;
+
+		for (size_t i = 0; i < uLength; i++)
+		{
+			h ^= (uint8_t)pLabel[i];
+			h *= 0x100000001B3ull;
+		}
+
+		return h;
+	}
+
+private:
+	static constexpr size_t Length(const utf8_t* szLabel)
+	{
+		size_t uLength = 0;
+
+		while (szLabel[uLength])
+			uLength++;
+
+		return uLength;
+	}
+
+	const utf8_t* m_pData;
+	size_t m_uLength;
+	uint64_t m_uHash;
+};
+
+// orders labels bytewise and lets a map find a Key without building a string
+struct LabelLess
+{
+	using is_transparent = void;
+
+	bool operator()(const utf8nodestring& a, const utf8nodestring& b) const { return a < b; }
+	bool operator()(const utf8nodestring& a, const Key& b) const { return a.compare(0, utf8nodestring::npos, b.GetData(), b.GetLength()) < 0; }
+	bool operator()(const Key& a, const utf8nodestring& b) const { return b.compare(0, utf8nodestring::npos, a.GetData(), a.GetLength()) > 0; }
+};
+
+// a begin/end pair for range-for
+template<typename Iterator>
+class Range
+{
+public:
+	Range(Iterator begin, Iterator end) : m_Begin(begin), m_End(end) {}
+
+	Iterator begin() const { return m_Begin; }
+	Iterator end() const { return m_End; }
+	bool empty() const { return m_Begin == m_End; }
+
+private:
+	Iterator m_Begin;
+	Iterator m_End;
+};
+
+// bytes a tree holds, as requested from its memory resource (the resource's own bookkeeping is not
+// included). storage shared between copies is counted once
+struct MemoryUsage
+{
+	size_t m_uStrings = 0;		// heap buffers of string values and of labels too long for the small string buffer
+	size_t m_uContainers = 0;	// element buffers by capacity, member map nodes and member hash indexes
+	size_t m_uNodes = 0;		// the reference counted block of every string, array and object
+
+	size_t GetTotal() const { return m_uStrings + m_uContainers + m_uNodes; }
+};
+
 class Node
 {
+	using Elements = std::vector<Node, Allocator<Node>>;
+	using Members = std::map<utf8nodestring, Node, LabelLess, Allocator<std::pair<const utf8nodestring, Node>>>;
+
 public:
 	enum class Type : uint_fast8_t
 	{
@@ -24,64 +116,187 @@ public:
 		Object
 	};
 
+	using MemberRange = Range<Members::iterator>;				// of std::pair<const utf8nodestring, Node>, ordered by label
+	using ConstMemberRange = Range<Members::const_iterator>;
+	using ElementRange = Range<Elements::iterator>;
+	using ConstElementRange = Range<Elements::const_iterator>;
+
 	Node();
 	~Node();
 
-	static Node Object();
-	static Node Array();
-	static Node String();
+	// containers and strings allocate from pResource, or the default resource when null
+	static Node Object(MemoryResource* pResource = nullptr);
+	static Node Array(MemoryResource* pResource = nullptr);
+	static Node String(MemoryResource* pResource = nullptr);
 
 	bool GetBool() const;
 	double GetNumber() const;
-	const utf8string& GetString() const;
-
-	// object functions
-	Node* Get(const utf8string& szLabel);
-	const Node* Get(const utf8string& szLabel) const;
-	void Set(const utf8string& szLabel, const Node& n);
-	bool GetOrDefault(const utf8string&, bool bDefault) const;
-	double GetOrDefault(const utf8string&, double dblDefault) const;
-	std::string GetOrDefault(const utf8string&, const utf8string& szDefault) const;
-	std::string GetOrDefault(const utf8string&, const utf8_t* szDefault) const;
-	void ForEachMember(const std::function<void(const std::string&, Node&)>& callback);
-	void ForEachMember(const std::function<void(const std::string&, const Node&)>& callback) const;
+	const utf8nodestring& GetString() const;
+
+	// object functions, a literal, either string type or pointer and length converts to a Key without allocating
+	Node* Get(const Key& label);
+	const Node* Get(const Key& label) const;
+	void Set(const Key& label, const Node& n);
+	void Set(const Key& label, Node&& n);
+	bool GetOrDefault(const Key& label, bool bDefault) const;
+	double GetOrDefault(const Key& label, double dblDefault) const;
+	utf8string GetOrDefault(const Key& label, const utf8string& szDefault) const;
+	utf8string GetOrDefault(const Key& label, const utf8_t* szDefault) const;
+	MemberRange members();
+	ConstMemberRange members() const;
 	size_t GetNumMembers() const;
 
+	// callback(const utf8nodestring& szLabel, Node& member), called directly rather than through std::function
+	template<typename Callback>
+	void ForEachMember(Callback&& callback)
+	{
+		for (auto& member : members())
+			callback(member.first, member.second);
+	}
+
+	template<typename Callback>
+	void ForEachMember(Callback&& callback) const
+	{
+		for (const auto& member : members())
+			callback(member.first, member.second);
+	}
+
 	// array functions
 	size_t Length() const;
+	size_t Capacity() const;
 	Node* At(size_t i);
 	void Append(const Node& n);
+	void Append(Node&& n);
 	void Insert(size_t i, const Node& n);
 	void Remove(size_t i);
 	Type GetElementType() const;
-	void ForEachElement(const std::function<void(Node&)>& callback);
-	void ForEachElement(const std::function<void(const Node&)>& callback) const;
+	ElementRange elements();
+	ConstElementRange elements() const;
+
+	template<typename Callback>
+	void ForEachElement(Callback&& callback)
+	{
+		for (Node& element : elements())
+			callback(element);
+	}
+
+	template<typename Callback>
+	void ForEachElement(Callback&& callback) const
+	{
+		for (const Node& element : elements())
+			callback(element);
+	}
 
 	inline Type GetType() const { return m_eType; }
 
+	// structural hash of this subtree, computed on first use and cached alongside the shared storage so
+	// every copy sees it; non-const access (Get, At, Set, Append, Insert, Remove, ForEach*, members, elements) drops the cache
+	// on every node along the path taken. a child cannot reach its parents, so a Node* kept from Get or At
+	// and written after a parent was hashed leaves that parent's hash stale; get the child again instead
+	uint64_t Hash() const;
+
+	// exact deep comparison, it returns early on shared storage or when two cached hashes disagree but
+	// walks equal trees in full (O(n)); Diff trusts matching hashes instead
+	bool Equals(const Node& other) const;
+
+	// true when the string or container is shared with another copy and the next mutation clones it
+	bool IsShared() const;
+
+	// true when Hash returns without walking the subtree, scalars and null always are
+	bool IsHashed() const;
+
+	// resource backing this node's string or container, null for scalars
+	MemoryResource* GetResource() const;
+
+	// memory held below this node, the Node itself is wherever its owner put it
+	MemoryUsage GetMemoryUsage() const;
+
+	// builds the member index of every object below this node large enough to get one, which the first
+	// lookup in such an object otherwise builds (and writes into storage it may share with other threads)
+	void BuildIndexes() const;
+
 	explicit Node(bool bValue);
 	Node(double dblValue);
-	explicit Node(const utf8_t* szValue);
-	explicit Node(const utf8string& szValue);
+	explicit Node(const utf8_t* szValue, MemoryResource* pResource = nullptr);
+	explicit Node(const utf8string& szValue, MemoryResource* pResource = nullptr);
+	explicit Node(const utf8nodestring& szValue);	// allocates from the same resource as szValue
 
+	// copies share the string or container of RHS, which is cloned one level at a time on mutation
 	Node& operator=(const Node& RHS);
+	Node& operator=(Node&& RHS) noexcept;
 	Node(const Node& RHS) noexcept;
 	Node(Node&& RHS) noexcept;
 
 private:
+	friend struct IncrementalEditor;
+	friend struct NodeBuilder;
+	friend struct NodeDiff;
+	friend struct NodeStorage;
+
+	// open addressed table of member hashes, see Node.cpp
+	struct LabelIndex;
+
+	// the members of an object, plus a hash index that the first lookup in a large object builds. the
+	// index points at map nodes, so a copy starts without one and structural changes drop it
+	struct Children : Members
+	{
+		explicit Children(const allocator_type& alloc) : Members(alloc) {}
+		Children(const Children& other) : Members(other) {}
+		~Children() { DropIndex(); }
+
+		void DropIndex();
+
+		mutable std::atomic<LabelIndex*> m_pIndex { nullptr };
+	};
+
+	// reference counted storage, allocated from the same resource as the value it holds
+	template<typename T>
+	struct Shared
+	{
+		template<typename... Args>
+		explicit Shared(Args&&... args) : m_uRefs(1), m_uHash(0), m_Value(std::forward<Args>(args)...) {}
+
+		std::atomic<uint32_t> m_uRefs;
+		mutable std::atomic<uint64_t> m_uHash; // zero until computed
+		T m_Value;
+	};
+
 	union
 	{
 		bool m_bValue;
 		double m_dblValue;
-		utf8string m_szValue;
-		std::vector<Node> m_vElements;
-		std::map<utf8string, Node> m_mChildren;
+		Shared<utf8nodestring>* m_pString = nullptr; // as wide as the union, so every member reads as zero
+		Shared<Elements>* m_pElements;
+		Shared<Children>* m_pChildren;
 	};
 
+	static const LabelIndex* GetIndex(const Children& children); // builds and publishes it on first use
+	static const Node* FindMember(const Children& children, const Key& label);
+
+	// the parts GetMemoryUsage adds up, also charged by Parse against ParserConfig::m_uMaxBytes
+	static size_t BlockBytes(Type eType);					// the shared block of a string, array or object
+	static size_t HeapBytes(const utf8nodestring& szValue);	// a string's buffer when it is not stored inline
+	static size_t MemberBytes();							// one map node, label and value included
+
 	void Reset();
+	void Init(Type eType, MemoryResource* pResource); // resets into an empty, unshared string or container
+
+	// write access, clones the storage first if it is shared and drops its cached hash
+	utf8nodestring& MutableString();
+	Elements& MutableElements();
+	Children& MutableChildren();
 
 	Type m_eType = Type::Null;
 	Type m_eElementType = Type::Null;
+	bool m_bTouched = false; // seen during a reparse, never copied
 };
 
+// reports the deepest differing nodes between two trees as JSON pointers (RFC 6901), with a null
+// pointer for a member or element that only exists on one side. subtrees with equal hashes are
+// skipped without looking inside, so once both trees are hashed the cost follows the size of the
+// change, not of the trees. bExact confirms every hash match with Equals to rule out a collision,
+// which walks the equal parts in full. returns the number of node pairs descended into
+using DiffCallback = std::function<void(const utf8string& szPath, const Node* pLHS, const Node* pRHS)>;
+size_t Diff(const Node& lhs, const Node& rhs, const DiffCallback& callback, bool bExact = false);
+
 }
\ No newline at end of file
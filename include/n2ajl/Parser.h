@@ -6,17 +6,98 @@
 namespace n2ajl
 {
 
+// filled in by every Parse call that is given one, previous contents are discarded
+struct ParserStats
+{
+	size_t m_uBytes = 0;			// input bytes consumed
+	size_t m_uNodes[6] = {};		// nodes created, indexed by Node::Type
+	size_t m_uStringBytes = 0;		// bytes copied into labels and string values
+	size_t m_uAllocations = 0;		// heap allocations for tree storage (shared string and container blocks, long strings, members, array growth)
+	size_t m_uMaxDepth = 0;			// deepest span reached, the root span is depth 1
+	size_t m_uSkippedBytes = 0;		// input bytes of values left out by the projection
+	uint64_t m_uScanNs = 0;			// locating the end of the input and skipping the BOM
+	uint64_t m_uBuildNs = 0;		// tokenizing and building the tree
+};
+
+class Projection;
+class Schema;
+
 struct ParserConfig
 {
 	size_t m_uMaxDepth = 16;
+	ParserStats* m_pStats = nullptr;	// optional, no counting code runs when this is null
+
+	// parse into the tree already in json, overwriting scalars, reusing string capacity and matching
+	// members and elements in place and trimming only what the new document no longer has;
+	// reparsing a document of unchanged shape does not allocate
+	bool m_bReuseNodes = false;
+
+	// hash every span as it closes so Node::Hash, Equals and Diff start from a fully cached tree
+	bool m_bComputeHashes = false;
+
+	// optional, only members on its paths become nodes. values left out are skipped without being
+	// decoded, they are only checked for terminated strings and balanced brackets within m_uMaxDepth
+	const Projection* m_pProjection = nullptr;
+
+	// optional, every value is checked against it as soon as it is complete (spans for their type as soon
+	// as they open), so an invalid document is rejected without building the rest of it
+	const Schema* m_pSchema = nullptr;
+
+	// optional limits, 0 for none. the parse stops at the value that would cross one, before building it
+	// where the cost is known up front, and fails with ErrorCode::TooLarge, TooManyNodes or StringTooLong
+	size_t m_uMaxBytes = 0;			// memory of the resulting tree as Node::GetMemoryUsage counts it
+	size_t m_uMaxNodes = 0;			// values of any type, spans included
+	size_t m_uMaxStringLength = 0;	// bytes of a string value or label as written, escapes undecoded
 };
 
+enum class ErrorCode : uint8_t
+{
+	None,
+	UnexpectedEnd,			// the input ended inside a span
+	TooDeep,				// a span nested beyond ParserConfig::m_uMaxDepth
+	UnexpectedCharacter,	// a character that cannot appear here, see Result::m_uChar
+	NonAscii,				// a non-ASCII character outside of a string
+	ExpectedSpan,			// the root is not an object or an array
+	BadLiteral,				// a literal that is not a number, true, false or null
+	EmptyLabel,
+	ExpectedLabel,
+	ExpectedColon,
+	MixedArray,				// an element whose type differs from the first element
+	ExpectedMember,			// a label without a value
+	UnterminatedSpan,		// a span without its closing bracket, the offset is where it began
+	BadSpanType,
+	SchemaType,				// a value of a type the schema does not allow
+	SchemaEnum,				// a value not among the schema's enum
+	SchemaRange,			// a number outside the schema's bounds
+	SchemaRequired,			// an object without a required member, the offset is where the object began
+	ReadFailed,				// IngestFiles could not open or read the file
+	BadEncoding,			// BinaryToJson found a malformed or unsupported item
+	TooLarge,				// the tree would exceed ParserConfig::m_uMaxBytes
+	TooManyNodes,			// more values than ParserConfig::m_uMaxNodes
+	StringTooLong,			// a string or label longer than ParserConfig::m_uMaxStringLength
+};
+
+// trivially copyable, nothing is formatted until GetMessage is called
 struct Result
 {
-	bool m_bSuccess;
-	std::string m_szMsg;
+	bool m_bSuccess = true;
+	ErrorCode m_eError = ErrorCode::None;
+	uint64_t m_uOffset = 0;				// bytes from the start of the input (including a BOM)
+	uint32_t m_uChar = 0;				// the offending character for UnexpectedCharacter and UnterminatedSpan
+	const utf8_t* m_pSource = nullptr;	// the input given to Parse, null for streamed input
+
+	// both walk the input up to the offset, so the input must still be alive; lines and columns start at 1,
+	// columns count codepoints
+	void GetLineColumn(uint64_t& uLine, uint64_t& uColumn) const;
+	std::string GetMessage() const;
 };
 
-Result Parse(const ParserConfig& cfg, const utf8_t* szJson, Node& json);
+// every string and container in the resulting tree is allocated from pResource (default resource when null)
+Result Parse(const ParserConfig& cfg, const utf8_t* szJson, Node& json, MemoryResource* pResource = nullptr);
+
+// checks pBuffer exactly as Parse would without building a tree or allocating, failures carry the same
+// error and offset Parse reports. a NUL within uLength ends the document like it does for Parse;
+// only cfg.m_uMaxDepth is used
+Result Validate(const ParserConfig& cfg, const utf8_t* pBuffer, size_t uLength);
 
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "UTF.h"
+
+namespace n2ajl
+{
+
+// the paths a parse keeps, compiled into a trie of member labels. paths are JSON pointers ("/user/id"),
+// whose tokens match labels as they appear in the input (escape sequences intact); everything below a
+// path is kept. arrays do not consume a token, their elements are projected like the array itself, so
+// "/items/id" keeps the id of every object in items
+class Projection
+{
+public:
+	// one trie node, a null entry keeps everything below it
+	struct Entry
+	{
+		std::vector<std::pair<std::string, uint32_t>> m_vChildren; // sorted by label, index into m_vEntries
+		bool m_bAll = false;
+	};
+
+	Projection();
+
+	// returns false for a path that is not a JSON pointer; "" keeps the whole document
+	bool Add(const char* szPath);
+
+	const Entry* GetRoot() const { return Resolve(0); }
+
+	// decodes the tokens of a JSON pointer, false if szPath is not one
+	static bool SplitPath(const char* szPath, std::vector<std::string>& vTokens);
+
+	// false if the member is left out, otherwise pChild is the entry for its value
+	bool Find(const Entry* pEntry, const utf8_t* pLabel, size_t uLength, const Entry*& pChild) const;
+
+private:
+	const Entry* Resolve(uint32_t uIndex) const { return m_vEntries[uIndex].m_bAll ? nullptr : &m_vEntries[uIndex]; }
+
+	std::vector<Entry> m_vEntries; // the root is the first
+};
+
+}
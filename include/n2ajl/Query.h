@@ -0,0 +1,94 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "Node.h"
+#include "Parser.h"
+#include "Projection.h"
+
+namespace n2ajl
+{
+
+// filled in by Query::Run
+struct QueryResult
+{
+	size_t m_uLines = 0;			// non-empty lines seen
+	size_t m_uPrefiltered = 0;		// rejected on their raw bytes, never parsed
+	size_t m_uParsed = 0;
+	size_t m_uErrors = 0;			// lines that failed to parse, they are skipped
+	size_t m_uMatched = 0;
+	std::vector<double> m_vAggregates; // one per Query::Aggregate call, in that order
+};
+
+// filters, projects and aggregates NDJSON one line at a time. paths are JSON pointers through objects
+// (see Projection), a path that runs into anything else has no value and fails every predicate.
+// a line is only parsed when it contains every literal the predicates imply (the raw label of each
+// path's last token, the raw string of an Equal string value, true/false/null for those), and then only
+// the paths the query refers to are built
+class Query
+{
+public:
+	enum class Compare : uint8_t
+	{
+		Exists,
+		Equal,			// Node::Equals, strings compare with their escape sequences intact
+		NotEqual,
+		Less,			// numbers numerically, strings bytewise, other types never order
+		LessEqual,
+		Greater,
+		GreaterEqual
+	};
+
+	enum class Function : uint8_t
+	{
+		Count,			// lines where the path exists, "" counts every matching line
+		Sum,			// the rest only take numbers, other values are passed over
+		Min,
+		Max				// Min and Max are NaN when no number was seen
+	};
+
+	// each returns false for a path that is not a JSON pointer
+	bool Where(const char* szPath, Compare eCompare, const Node& value = Node());
+	bool Select(const char* szPath); // matching lines are handed out with only the selected paths
+	bool Aggregate(Function eFunction, const char* szPath);
+
+	// an extra literal that every matching line is known to contain
+	void Require(const char* szLiteral);
+
+	using MatchCallback = std::function<void(const Node& line)>;
+
+	// lines end at '\n' (a preceding '\r' is dropped); onMatch may be empty when only aggregating
+	QueryResult Run(const ParserConfig& cfg, const utf8_t* pData, size_t uLength, const MatchCallback& onMatch = MatchCallback()) const;
+
+private:
+	struct Path
+	{
+		std::vector<utf8string> m_vTokens;
+		std::string m_szPointer;
+	};
+
+	struct Predicate
+	{
+		Path m_Path;
+		Compare m_eCompare;
+		Node m_Value;
+	};
+
+	struct Aggregation
+	{
+		Path m_Path;
+		Function m_eFunction;
+	};
+
+	static bool MakePath(const char* szPath, Path& path);
+	static const Node* Resolve(const Node& root, const Path& path);
+	static bool Test(const Predicate& predicate, const Node& root);
+
+	std::vector<Predicate> m_vPredicates;
+	std::vector<Path> m_vSelected;
+	std::vector<Aggregation> m_vAggregations;
+	std::vector<std::string> m_vLiterals;
+};
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Node.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace n2ajl
+{
+
+// frees dropped trees away from the threads that drop them. with a background thread each retired tree is
+// freed there as soon as it arrives; without one, trees wait until Drain frees them as one batch at a point
+// the owner picks, such as between requests. a tree is freed through its resource on whichever thread
+// does the freeing, so that resource must allow it and must outlive the tree's time in the queue
+class Reclaimer
+{
+public:
+	explicit Reclaimer(bool bBackground = true);
+	~Reclaimer(); // frees every tree still queued, then joins
+
+	Reclaimer(const Reclaimer&) = delete;
+	Reclaimer& operator=(const Reclaimer&) = delete;
+
+	// takes the tree and leaves json null. storage still shared with a copy stays with that copy
+	void Retire(Node&& json);
+
+	// frees what is queued on the calling thread, returns the number of trees freed
+	size_t Drain();
+
+	size_t GetNumPending() const;
+
+private:
+	void WorkerMain();
+
+	// Drain and the worker swap the queue with an emptied batch, so its capacity is kept and Retire
+	// only allocates while the queue grows past its largest size so far
+	std::vector<Node> m_vQueue;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::thread m_Thread;
+	bool m_bStop = false;
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Parser.h"
+#include "Serializer.h"
+
+namespace n2ajl
+{
+
+class SinkBuffer;
+
+// re-indents or minifies JSON text as it arrives, without building a tree. whitespace outside strings is
+// dropped and, with SerializerConfig::m_bFancy, reinserted in Serialize's layout; strings, numbers and
+// literals are copied byte for byte, members keep their input order and trailing commas are dropped.
+// only the structure is checked, run Validate first where Parse's rules for literals and arrays matter.
+// input without a root span (only whitespace, or a NUL before it) becomes null, as Parse reads it.
+// spans nest at most ParserConfig::m_uMaxDepth deep, the only setting of parserCfg used, so memory is the
+// output buffer plus one byte per open span however large the input
+class Reformatter
+{
+public:
+	Reformatter(const ParserConfig& parserCfg, const SerializerConfig& cfg, SerializeSink sink, size_t uBufferSize = 64 * 1024);
+	~Reformatter();
+
+	Reformatter(const Reformatter&) = delete;
+	Reformatter& operator=(const Reformatter&) = delete;
+
+	// chunks may split the input anywhere, returns false once an error was found (later input is ignored)
+	bool Feed(const utf8_t* pData, size_t uLength);
+
+	// hands the remaining output to the sink. offsets in the result count bytes of the whole stream, there
+	// is no source to walk so GetMessage reports them as they are and GetLineColumn cannot be used
+	Result Finish();
+
+private:
+	enum class State : uint8_t
+	{
+		Root,
+		Label,			// expecting a label or the end of an object
+		LabelString,
+		Colon,
+		Member,			// expecting the value of a member
+		Element,		// expecting an element or the end of an array
+		String,
+		Literal,
+		AfterValue,
+		Done,
+		Failed
+	};
+
+	bool OpenValue(utf8_t ch, size_t i);
+	bool Close(utf8_t ch, size_t i);
+	void NullRoot();
+	void ChildPrefix();
+	void Indent(size_t uDepth);
+
+	bool Fail(ErrorCode eError, uint64_t uOffset, uint32_t uChar = 0);
+
+	SerializerConfig m_Cfg;
+	SerializeSink m_Sink;
+	std::unique_ptr<SinkBuffer> m_pOut;	// writes to m_Sink
+
+	std::vector<uint8_t> m_vSpans;	// one per open span, see s_uObject and s_uChildren in the source
+	size_t m_uMaxDepth;
+	State m_eState = State::Root;
+	bool m_bEscape = false;
+	uint64_t m_uOffset = 0;			// stream bytes fed before the current chunk
+	uint64_t m_uTokenStart = 0;		// where the current label started, for EmptyLabel
+	Result m_Result;
+};
+
+// reformats a complete document into szOut
+Result Reformat(const ParserConfig& parserCfg, const SerializerConfig& cfg, const utf8_t* pData, size_t uLength, utf8string& szOut);
+
+}
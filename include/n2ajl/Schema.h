@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Node.h"
+#include "Parser.h"
+
+namespace n2ajl
+{
+
+// a JSON Schema subset compiled into a table the parser checks as it builds, see ParserConfig::m_pSchema.
+// supported keywords: type (a name or an array of names, "integer" included), enum, minimum, maximum,
+// exclusiveMinimum and exclusiveMaximum (as numbers), required (at most 64 per object), properties and
+// items (a single schema); true and false are accepted as schemas, other keywords are ignored.
+// property labels match member labels as they appear in the input, escape sequences intact
+class Schema
+{
+public:
+	// one compiled schema, a null entry accepts anything
+	struct Entry
+	{
+		struct Property
+		{
+			std::string m_szLabel;
+			uint32_t m_uEntry;		// s_uAny when the property has no schema of its own
+			uint64_t m_uRequired;	// this property's bit in Entry::m_uRequired, zero when optional
+		};
+
+		uint8_t m_uTypes = 0xFF;	// a bit per Node::Type plus s_uInteger
+		bool m_bMinimum = false;
+		bool m_bMaximum = false;
+		bool m_bExclusiveMinimum = false;
+		bool m_bExclusiveMaximum = false;
+		double m_dblMinimum = 0.0;
+		double m_dblMaximum = 0.0;
+		double m_dblExclusiveMinimum = 0.0;
+		double m_dblExclusiveMaximum = 0.0;
+		uint32_t m_uItems = s_uAny;
+		uint64_t m_uRequired = 0;
+		std::vector<Property> m_vProperties; // sorted by label
+		std::vector<Node> m_vEnum;
+	};
+
+	static const uint32_t s_uAny = UINT32_MAX;
+	static const uint8_t s_uInteger = 1 << 6; // numbers without a fraction, implied by the Number bit
+
+	// false if schema uses a supported keyword in an unsupported way, the previous table is kept then
+	bool Compile(const Node& schema);
+
+	const Entry* GetRoot() const { return Resolve(m_vEntries.empty() ? s_uAny : 0); }
+	const Entry* GetItems(const Entry* pEntry) const { return Resolve(pEntry->m_uItems); }
+
+	// the entry for a member's value, uRequired is its bit in the object's required set (zero if optional)
+	const Entry* FindProperty(const Entry* pEntry, const utf8_t* pLabel, size_t uLength, uint64_t& uRequired) const;
+
+	// early check for a span whose contents are still to come
+	ErrorCode CheckType(const Entry* pEntry, Node::Type eType) const;
+
+	// type, enum and range of a complete value; required members are the parser's to track
+	ErrorCode CheckValue(const Entry* pEntry, const Node& value) const;
+
+private:
+	const Entry* Resolve(uint32_t uIndex) const { return uIndex == s_uAny ? nullptr : &m_vEntries[uIndex]; }
+
+	std::vector<Entry> m_vEntries; // the root is the first
+};
+
+}
@@ -1,11 +1,25 @@
 #pragma once
 
+#include <functional>
 #include <string>
+#include <vector>
 #include "Node.h"
 
 namespace n2ajl
 {
 
+// filled in by every Serialize call that is given one, previous contents are discarded
+struct SerializerStats
+{
+	size_t m_uNodes[6] = {};		// nodes written, indexed by Node::Type
+	size_t m_uOutputBytes = 0;
+	size_t m_uReallocations = 0;	// times the output buffer had to grow
+	size_t m_uMaxDepth = 0;			// deepest span written, the root span is depth 1
+	uint64_t m_uNs = 0;
+};
+
+class ThreadPool;
+
 struct SerializerConfig
 {
 	enum class Indentation
@@ -17,8 +31,52 @@ struct SerializerConfig
 
 	Indentation m_eIndentation = Indentation::FourSpace;
 	bool m_bFancy = false;
+	SerializerStats* m_pStats = nullptr;	// optional, no counting code runs when this is null
+
+	// Serialize measures the exact output size in a first pass and writes into a single allocation
+	bool m_bExactSize = false;
 };
 
 utf8string Serialize(const SerializerConfig& cfg, const Node& json);
 
+// writes into pBuffer and returns the size of the complete output, which is only all there when it is no
+// larger than uCapacity; call again with a buffer of the returned size otherwise. nothing is allocated
+// and no terminator is written
+size_t SerializeTo(const SerializerConfig& cfg, const Node& json, utf8_t* pBuffer, size_t uCapacity);
+
+// same layout as POSIX struct iovec, an array of these can be passed to writev as is
+struct IoSlice
+{
+	const utf8_t* m_pData;
+	size_t m_uLength;
+};
+
+// output of SerializeGather, reuse one across calls to keep its buffers
+class GatherOutput
+{
+public:
+	const IoSlice* GetSlices() const { return m_vSlices.data(); }
+	size_t GetNumSlices() const { return m_vSlices.size(); } // may exceed IOV_MAX, writev in batches
+	size_t GetSize() const { return m_uSize; }
+
+private:
+	friend class GatherWriter;
+
+	utf8string m_szScratch; // structural bytes, numbers and short strings
+	std::vector<IoSlice> m_vSlices;
+	size_t m_uSize = 0;
+};
+
+// serializes into slices of a scratch buffer and, for string values of at least uMinReference bytes, of the
+// tree itself; the slices are only valid while json is alive and unchanged and until out is reused
+void SerializeGather(const SerializerConfig& cfg, const Node& json, GatherOutput& out, size_t uMinReference = 256);
+
+// serializes runs of children of large arrays and objects concurrently on pool and joins them, the output
+// is identical to Serialize. runs are cut by child count, so arrays of similar records scale best
+utf8string SerializeParallel(const SerializerConfig& cfg, const Node& json, ThreadPool& pool);
+
+// as above, but hands the output to sink in order, each stretch once it and everything before it is written
+using SerializeSink = std::function<void(const utf8_t* pData, size_t uLength)>;
+void SerializeParallel(const SerializerConfig& cfg, const Node& json, ThreadPool& pool, const SerializeSink& sink);
+
 }
\ No newline at end of file
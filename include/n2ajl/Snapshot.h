@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Node.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace n2ajl
+{
+
+// an immutable document, only const access to the tree is handed out. Freeze computes every hash and
+// member index, so reading a snapshot never writes to it and any number of threads may read it at once
+class Snapshot
+{
+public:
+	Snapshot() = default; // a null document
+
+	const Node& GetRoot() const { return m_Root; }
+	const Node& operator*() const { return m_Root; }
+	const Node* operator->() const { return &m_Root; }
+
+private:
+	friend Snapshot Freeze(Node json);
+
+	Node m_Root;
+};
+
+// storage shared with other copies of json stays shared, those copies clone before they mutate
+Snapshot Freeze(Node json);
+
+// holds the current snapshot for concurrent readers. readers never lock and only write to a slot owned
+// by their thread; replaced snapshots are reclaimed once no reader that could have seen them remains
+class AtomicSnapshot
+{
+public:
+	class ReadGuard
+	{
+	public:
+		ReadGuard(ReadGuard&& other) noexcept;
+		~ReadGuard();
+
+		ReadGuard(const ReadGuard&) = delete;
+		ReadGuard& operator=(const ReadGuard&) = delete;
+		ReadGuard& operator=(ReadGuard&&) = delete;
+
+		// valid for the lifetime of the guard, copy the snapshot to keep it longer
+		const Snapshot& GetSnapshot() const { return *m_pSnapshot; }
+		const Node& operator*() const { return m_pSnapshot->GetRoot(); }
+		const Node* operator->() const { return &m_pSnapshot->GetRoot(); }
+
+	private:
+		friend class AtomicSnapshot;
+
+		ReadGuard(std::atomic<uint64_t>* pSlot, const Snapshot* pSnapshot) : m_pSlot(pSlot), m_pSnapshot(pSnapshot) {}
+
+		std::atomic<uint64_t>* m_pSlot;
+		const Snapshot* m_pSnapshot;
+	};
+
+	// threads beyond uSlots share slots, which stays correct but may delay reclamation
+	explicit AtomicSnapshot(Snapshot initial = Snapshot(), size_t uSlots = 64);
+	~AtomicSnapshot(); // no reader may remain
+
+	AtomicSnapshot(const AtomicSnapshot&) = delete;
+	AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+	// lock free, guards may be nested within a thread
+	ReadGuard Read() const;
+
+	// replaces the current snapshot and frees every replaced one that can no longer be read
+	void Publish(Snapshot snapshot);
+
+	// frees what can be freed without publishing, returns the number of snapshots still pending
+	size_t Reclaim();
+
+private:
+	// one per cache line: reader count in the low bits, the oldest epoch a reader entered with above
+	struct Slot
+	{
+		std::atomic<uint64_t> m_uState;
+		char m_Padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	struct Retired
+	{
+		const Snapshot* m_pSnapshot;
+		uint64_t m_uEpoch; // first epoch in which no reader could obtain it
+	};
+
+	size_t ReclaimLocked();
+
+	// both are only written by Publish, readers merely load them
+	std::atomic<const Snapshot*> m_pCurrent;
+	std::atomic<uint64_t> m_uEpoch{ 1 };
+
+	char* m_pSlotMemory;	// over-allocated so the slots start on a cache line
+	Slot* m_pSlots;
+	size_t m_uSlots;
+
+	std::mutex m_WriterMutex; // serializes writers only
+	std::vector<Retired> m_vRetired;
+};
+
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdlib>
+#include "Parser.h"
+
+namespace n2ajl
+{
+
+class TapeDocument;
+
+// one value of a TapeDocument, read like a const Node. a view is two pointers and is passed by value;
+// it stays valid until the document is parsed again or destroyed. strings and labels point into the
+// document's string buffer, NUL terminated and with escape sequences intact as in Node. members are
+// visited in document order and a label repeated within an object finds its last value, as Parse keeps
+class NodeView
+{
+public:
+	NodeView() = default; // what Get returns for a missing member
+
+	explicit operator bool() const { return m_pWord != nullptr; }
+
+	Node::Type GetType() const { return (Node::Type)(m_pWord[0] >> s_uTagShift); }
+
+	bool GetBool() const { Check(Node::Type::Boolean); return (m_pWord[0] & 1) != 0; }
+	double GetNumber() const;
+	const utf8_t* GetString() const { Check(Node::Type::String); return m_pStrings + GetPayload(m_pWord[0]); }
+	size_t GetStringLength() const { Check(Node::Type::String); return (size_t)m_pWord[1]; }
+
+	// object functions. Get walks the members, stepping over each value in one move
+	NodeView Get(const Key& label) const;
+	bool GetOrDefault(const Key& label, bool bDefault) const;
+	double GetOrDefault(const Key& label, double dblDefault) const;
+	const utf8_t* GetOrDefault(const Key& label, const utf8_t* szDefault) const;
+	size_t GetNumMembers() const { Check(Node::Type::Object); return GetCount(); }
+
+	// callback(const utf8_t* pLabel, size_t uLabelLength, NodeView member)
+	template<typename Callback>
+	void ForEachMember(Callback&& callback) const
+	{
+		Check(Node::Type::Object);
+
+		for (const uint64_t* p = m_pWord + 1; GetTag(*p) == s_uLabelTag;)
+		{
+			NodeView member(p + 2, m_pStrings);
+			callback(m_pStrings + GetPayload(p[0]), (size_t)p[1], member);
+			p = member.GetNext();
+		}
+	}
+
+	// array functions. At walks the elements before i, stepping over each in one move
+	size_t Length() const { Check(Node::Type::Array); return GetCount(); }
+	NodeView At(size_t i) const;
+	Node::Type GetElementType() const;
+
+	template<typename Callback>
+	void ForEachElement(Callback&& callback) const
+	{
+		Check(Node::Type::Array);
+
+		for (const uint64_t* p = m_pWord + 1; GetTag(*p) != s_uEndTag;)
+		{
+			NodeView element(p, m_pStrings);
+			callback(element);
+			p = element.GetNext();
+		}
+	}
+
+	// copies the value into a regular tree, for when it has to be changed or kept past the document
+	Node ToNode(MemoryResource* pResource = nullptr) const;
+
+private:
+	friend class TapeDocument;
+	friend struct TapeBuilder;
+
+	// each word holds a tag in its top byte. a number is followed by a word with the bits of its double,
+	// a string or label by one with its length. a span's word holds the distance to the word after its
+	// end word, which holds the number of members or elements
+	static const uint64_t s_uTagShift = 56;
+	static const uint64_t s_uEndTag = 6;
+	static const uint64_t s_uLabelTag = 7;
+
+	NodeView(const uint64_t* pWord, const utf8_t* pStrings) : m_pWord(pWord), m_pStrings(pStrings) {}
+
+	static uint64_t GetTag(uint64_t uWord) { return uWord >> s_uTagShift; }
+	static uint64_t GetPayload(uint64_t uWord) { return uWord & ((uint64_t(1) << s_uTagShift) - 1); }
+
+	// the word after this value, the next sibling or its parent's end word
+	const uint64_t* GetNext() const
+	{
+		switch (GetType())
+		{
+			case Node::Type::Number:
+			case Node::Type::String:
+				return m_pWord + 2;
+			case Node::Type::Array:
+			case Node::Type::Object:
+				return m_pWord + GetPayload(m_pWord[0]);
+			default:
+				return m_pWord + 1;
+		}
+	}
+
+	size_t GetCount() const { return (size_t)GetPayload(m_pWord[GetPayload(m_pWord[0]) - 1]); }
+
+	void Check(Node::Type eType) const
+	{
+		if (GetType() != eType)
+			std::abort();
+	}
+
+	const uint64_t* m_pWord = nullptr;
+	const utf8_t* m_pStrings = nullptr;
+};
+
+// a parsed document as one array of 64-bit words in document order plus one buffer holding every
+// string and label, for documents that are only read. both are sized from the input before the parse
+// starts, so a parse allocates twice at most (once per buffer, the tape reserving a word per input
+// byte) and not at all when the document is parsed into again with enough capacity left. reading
+// moves forward through memory and skips a whole span by the distance its first word holds
+class TapeDocument
+{
+public:
+	explicit TapeDocument(MemoryResource* pResource = nullptr);
+
+	// checks pJson exactly as Validate does (only cfg.m_uMaxDepth is used) and fails with the same error
+	// and offset Parse reports, leaving a null root. a NUL within uLength ends the document
+	Result Parse(const ParserConfig& cfg, const utf8_t* pJson, size_t uLength);
+
+	NodeView GetRoot() const;
+
+	// words and string bytes in use, the capacity reserved for them may be larger
+	size_t GetTapeSize() const { return m_vTape.size(); }
+	size_t GetStringBytes() const { return m_szStrings.size(); }
+
+private:
+	friend struct TapeBuilder;
+
+	std::vector<uint64_t, Allocator<uint64_t>> m_vTape;
+	utf8nodestring m_szStrings;
+};
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace n2ajl
+{
+
+// fixed set of worker threads running queued tasks in submission order
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t uThreads = 0); // 0 uses one thread per hardware thread
+	~ThreadPool(); // runs every task already queued, then joins
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t GetNumThreads() const { return m_vThreads.size(); }
+
+	void Submit(std::function<void()> task);
+
+	// runs one queued task on the calling thread, returns false if there was none
+	bool RunPending();
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> m_vThreads;
+	std::deque<std::function<void()>> m_Tasks;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	bool m_bStop = false;
+};
+
+// tracks a batch of tasks; Wait helps run queued tasks, so it is safe to call from a pool thread
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& pool) : m_Pool(pool) {}
+	~TaskGroup() { Wait(); }
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	void Run(std::function<void()> task);
+	void Wait();
+
+private:
+	ThreadPool& m_Pool;
+	std::atomic<size_t> m_uPending{ 0 };
+	std::mutex m_Mutex;
+	std::condition_variable m_Done;
+};
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Parser.h"
+#include "Serializer.h"
+
+namespace n2ajl
+{
+
+enum class BinaryFormat : uint8_t
+{
+	MessagePack,
+	CBOR
+};
+
+// converts JSON straight into MessagePack or CBOR without building a tree. the input is checked exactly
+// as Validate checks it (only cfg.m_uMaxDepth is used) and errors are reported the same way.
+// string escapes are decoded, integers that fit 64 bits become integers and other numbers doubles.
+// output goes through a buffer of uBufferSize bytes to sink:
+//  - CBOR is written in a single pass, spans use indefinite lengths. the sink may already have received
+//    part of a document that later turns out to be invalid
+//  - MessagePack needs every count up front, so a first pass records them (4 bytes per span) and
+//    nothing is written for an invalid document
+Result JsonToBinary(BinaryFormat eFormat, const ParserConfig& cfg, const utf8_t* pJson, size_t uLength, const SerializeSink& sink, size_t uBufferSize = 64 * 1024);
+Result JsonToBinary(BinaryFormat eFormat, const ParserConfig& cfg, const utf8_t* pJson, size_t uLength, utf8string& szOut);
+
+// converts a single MessagePack or CBOR item into minified JSON. strings are escaped, integer map keys
+// become strings, NaN and infinities become null, CBOR tags are dropped and undefined is null.
+// binary strings, extension types and other map keys fail with ErrorCode::BadEncoding, as do malformed
+// items and bytes after the item; offsets count bytes of pData and nesting is limited by cfg.m_uMaxDepth
+Result BinaryToJson(BinaryFormat eFormat, const ParserConfig& cfg, const uint8_t* pData, size_t uLength, const SerializeSink& sink, size_t uBufferSize = 64 * 1024);
+Result BinaryToJson(BinaryFormat eFormat, const ParserConfig& cfg, const uint8_t* pData, size_t uLength, utf8string& szOut);
+
+}
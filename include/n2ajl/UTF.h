@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 namespace n2ajl
 {
@@ -35,6 +37,26 @@ public:
 		last_read = nullptr;
 	}
 
+	// stops at a NUL within the first length bytes, str need not be terminated
+	UTF8Iterator(const utf8_t* str, size_t length)
+	{
+		units = (const uint8_t*)str;
+		end = (const uint8_t*)memchr(units, 0, length);
+
+		if (!end)
+			end = units + length;
+
+		if (units + 3 <= end &&
+			units[0] == 0xEF &&
+			units[1] == 0xBB &&
+			units[2] == 0xBF)
+			units += 3;
+
+		pos = 0;
+		n = 0;
+		last_read = nullptr;
+	}
+
 	utf32_t Read()
 	{
 		if (units >= end) { return 0; }
@@ -101,6 +123,13 @@ public:
 		return true;
 	}
 
+	// moves to str, a codepoint boundary further into the input; what is skipped is not counted by GetPosition
+	void Seek(const utf8_t* str)
+	{
+		units = (const uint8_t*)str;
+		last_read = nullptr;
+	}
+
 	size_t GetNumBytesLeft() const { return end - units; }
 	size_t GetPosition() const { return pos; }
 	size_t GetCodepointBytes() const { return n; }
@@ -0,0 +1,550 @@
+#pragma once
+
+// the byte level tokenizer shared by Validate and the transcoders, and the scanning helpers the other
+// byte scanners (Query, Reformatter) use, not part of the public headers
+
+#include <n2ajl/Parser.h>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define N2AJL_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace n2ajl
+{
+
+#if N2AJL_SSE2
+inline uint32_t CountTrailingZeros(uint32_t uMask)
+{
+#ifdef _MSC_VER
+	unsigned long uIndex;
+	_BitScanForward(&uIndex, uMask);
+	return (uint32_t)uIndex;
+#else
+	return (uint32_t)__builtin_ctz(uMask);
+#endif
+}
+#endif
+
+inline bool IsWhitespaceByte(uint8_t ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+inline bool IsTerminatorByte(uint32_t ch)
+{
+	return ch == ',' || ch == ']' || ch == '}';
+}
+
+// the number grammar below is always consumed whole by strtod, anything else is left to strtod itself
+inline bool IsPlainNumber(const uint8_t* z, size_t uLength)
+{
+	const uint8_t* p = z;
+	const uint8_t* pEnd = z + uLength;
+
+	auto Digits = [&]()
+	{
+		const uint8_t* pStart = p;
+
+		while (p < pEnd && *p >= '0' && *p <= '9')
+			p++;
+
+		return p != pStart;
+	};
+
+	if (p < pEnd && *p == '-')
+		p++;
+
+	if (!Digits())
+		return false;
+
+	if (p < pEnd && *p == '.')
+	{
+		p++;
+
+		if (!Digits())
+			return false;
+	}
+
+	if (p < pEnd && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+
+		if (p < pEnd && (*p == '+' || *p == '-'))
+			p++;
+
+		if (!Digits())
+			return false;
+	}
+
+	return p == pEnd;
+}
+
+// receives what ByteTokenizer reads, in document order; every call is inlined, so a handler with empty
+// functions costs nothing. strings and labels are handed over raw, escape sequences intact
+struct NullHandler
+{
+	void OnBegin(bool /*bObject*/) {}
+	void OnEnd(bool /*bObject*/, size_t /*uCount*/) {}		// uCount is the number of members or elements
+	void OnLabel(const uint8_t* /*pLabel*/, size_t /*uLength*/) {}
+	void OnString(const uint8_t* /*pValue*/, size_t /*uLength*/) {}
+	void OnNumber(const uint8_t* /*pValue*/, size_t /*uLength*/) {}	// text accepted by strtod
+	void OnBoolean(bool /*bValue*/) {}
+	void OnNull() {}
+	void OnExtent(const uint8_t* /*pStart*/, const uint8_t* /*pEnd*/) {}	// the bytes of the value just read, after its other calls
+};
+
+// mirrors GenerateNodes in Parser.cpp decision for decision, but walks bytes instead of codepoints and
+// only remembers the type of each value; any change to what Parse accepts has to be made in both.
+// Validate runs it with NullHandler, the transcoders with handlers that encode as they go
+template<typename Handler>
+class ByteTokenizer
+{
+public:
+	ByteTokenizer(const uint8_t* p, const uint8_t* pEnd, size_t uMaxDepth, Handler& handler) : m_p(p), m_pEnd(pEnd), m_uMaxDepth(uMaxDepth), m_Handler(handler) {}
+
+	bool Span(size_t uCurDepth, Node::Type& eType)
+	{
+		const uint8_t* pScopeStart = m_p;
+		const uint8_t* pOpen = m_p; // the bracket, past any whitespace before the root
+		const uint8_t* pLabelEnd = nullptr;
+		bool bLabel = false;
+		bool bColon = false;
+		bool bTerminated = false;
+		size_t uCount = 0;
+		Node::Type eFirst = Node::Type::Null; // arrays hold a single type, that of the first element
+		utf32_t ch = 0;
+
+		eType = Node::Type::Null;
+
+		if (!SkipWhitespace())
+			return false;
+
+		while ((ch = Read()))
+		{
+			if (ch >= 0x7F)
+				return Fail(ErrorCode::NonAscii, m_p);
+
+			if (eType == Node::Type::Null)
+			{
+				if (ch == '{')
+					eType = Node::Type::Object;
+				else if (ch == '[')
+					eType = Node::Type::Array;
+				else
+					return Fail(ErrorCode::ExpectedSpan, m_p, ch);
+
+				pOpen = m_p;
+				m_Handler.OnBegin(eType == Node::Type::Object);
+				StructureAdvance();
+				continue;
+			}
+			else if ((ch == '}' && eType == Node::Type::Object) ||
+					 (ch == ']' && eType == Node::Type::Array))
+			{
+				m_p++;
+				bTerminated = true;
+				break;
+			}
+
+			Node::Type eValue = Node::Type::Null;
+
+			if (eType == Node::Type::Object)
+			{
+				if (!bLabel)
+				{
+					if (ch != '\"')
+						return Fail(ErrorCode::ExpectedLabel, m_p);
+
+					bLabel = true;
+
+					const uint8_t* pStart = m_p;
+					size_t uLabelLength = 0;
+
+					if (!NextString(uLabelLength))
+						return Fail(ErrorCode::UnexpectedCharacter, pStart, ch);
+
+					if (!uLabelLength)
+						return Fail(ErrorCode::EmptyLabel, pStart);
+
+					m_Handler.OnLabel(pStart + 1, uLabelLength);
+					pLabelEnd = m_p;
+
+					if (!SkipWhitespace())
+						return false;
+
+					continue;
+				}
+
+				if (!bColon)
+				{
+					if (ch != ':')
+						return Fail(ErrorCode::ExpectedColon, m_p);
+
+					bColon = true;
+					StructureAdvance();
+					continue;
+				}
+
+				if (!Value(uCurDepth, ch, eValue))
+					return false;
+
+				uCount++;
+			}
+			else
+			{
+				if (!Value(uCurDepth, ch, eValue))
+					return false;
+
+				if (++uCount == 1)
+					eFirst = eValue;
+				else if (eValue != eFirst)
+					return Fail(ErrorCode::MixedArray, m_p);
+			}
+
+			if (!IsTerminatorByte(ch)) // we're expecting a terminator after a member
+				return Fail(ErrorCode::UnexpectedCharacter, m_p, ch);
+
+			bLabel = false;
+			bColon = false;
+			pLabelEnd = nullptr;
+
+			if (ch == ',')
+				StructureAdvance();
+		}
+
+		if (eType == Node::Type::Object && pLabelEnd)
+			return Fail(ErrorCode::ExpectedMember, pLabelEnd);
+
+		if (eType != Node::Type::Null && !bTerminated)
+			return Fail(ErrorCode::UnterminatedSpan, pScopeStart, eType == Node::Type::Object ? '{' : '[');
+
+		m_Handler.OnEnd(eType == Node::Type::Object, uCount);
+		m_Handler.OnExtent(pOpen, m_p);
+		return true;
+	}
+
+	ErrorCode m_eError = ErrorCode::None;
+	const uint8_t* m_pError = nullptr;
+	uint32_t m_uChar = 0;
+
+private:
+	bool Fail(ErrorCode eError, const uint8_t* pAt, uint32_t uChar = 0)
+	{
+		m_eError = eError;
+		m_pError = pAt;
+		m_uChar = uChar;
+		return false;
+	}
+
+	// the codepoint at the cursor, zero at the end or for a malformed one (same rules as UTF8Iterator::Read)
+	utf32_t Read() const
+	{
+		if (m_p >= m_pEnd)
+			return 0;
+
+		utf32_t ch = *m_p;
+		if (ch < 0x80)
+			return ch;
+
+		size_t n = CodepointBytes(*m_p);
+		if (!n || m_p + n > m_pEnd)
+			return 0;
+
+		ch &= ~(uint32_t(-1) << (7 - n));
+
+		for (size_t i = 1; i < n; i++)
+		{
+			if (m_p[i] >> 6 != 0b10)
+				return 0;
+
+			ch = (ch << 6) | (m_p[i] & 0x3F);
+		}
+
+		return ch <= 0x10FFFF ? ch : 0;
+	}
+
+	// like UTF8Iterator::Advance only the leading byte is checked
+	bool Advance()
+	{
+		if (m_p >= m_pEnd)
+			return false;
+
+		size_t n = CodepointBytes(*m_p);
+		if (!n || m_p + n > m_pEnd)
+			return false;
+
+		m_p += n;
+		return true;
+	}
+
+	static size_t CodepointBytes(uint8_t uLead)
+	{
+		if (uLead < 0x80)			{ return 1; }
+		if (uLead >> 5 == 0b110)	{ return 2; }
+		if (uLead >> 4 == 0b1110)	{ return 3; }
+		if (uLead >> 3 == 0b11110)	{ return 4; }
+		return 0;
+	}
+
+	bool SkipWhitespace()
+	{
+		if (m_p >= m_pEnd || !Read())
+			return Fail(ErrorCode::UnexpectedEnd, m_p);
+
+		SkipWhitespaceBytes();
+		return true;
+	}
+
+	void SkipWhitespaceBytes()
+	{
+		// minified input rarely has any, indentation runs are worth a vector compare
+		if (m_p >= m_pEnd || !IsWhitespaceByte(*m_p))
+			return;
+
+#if N2AJL_SSE2
+		const __m128i space = _mm_set1_epi8(' ');
+		const __m128i tab = _mm_set1_epi8('\t');
+		const __m128i lf = _mm_set1_epi8('\n');
+		const __m128i cr = _mm_set1_epi8('\r');
+
+		while (m_pEnd - m_p >= 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)m_p);
+			__m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+									  _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+			uint32_t uMask = ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+
+			if (uMask)
+			{
+				m_p += CountTrailingZeros(uMask);
+				return;
+			}
+
+			m_p += 16;
+		}
+#endif
+
+		while (m_p < m_pEnd && IsWhitespaceByte(*m_p))
+			m_p++;
+	}
+
+	// past any run of ASCII other than quotes and backslashes, those never fail to read
+	void SkipPlainStringBytes()
+	{
+#if N2AJL_SSE2
+		const __m128i quote = _mm_set1_epi8('\"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+
+		while (m_pEnd - m_p >= 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)m_p);
+			uint32_t uMask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+			uMask |= (uint32_t)_mm_movemask_epi8(v); // non-ASCII
+
+			if (uMask)
+			{
+				m_p += CountTrailingZeros(uMask);
+				return;
+			}
+
+			m_p += 16;
+		}
+#endif
+
+		while (m_p < m_pEnd && *m_p < 0x80 && *m_p != '\"' && *m_p != '\\')
+			m_p++;
+	}
+
+	// the cursor is on the opening quote, leaves it past the closing one
+	bool NextString(size_t& uLength)
+	{
+		const uint8_t* pStart = ++m_p;
+
+		for (;;)
+		{
+			SkipPlainStringBytes();
+
+			if (m_p >= m_pEnd)
+				return false; // non-terminated string...
+
+			if (*m_p == '\"')
+			{
+				uLength = m_p - pStart;
+				m_p++;
+				return true;
+			}
+
+			if (*m_p == '\\')
+				m_p++; // whatever follows is taken as is, but still has to be readable
+
+			if (!Read())
+				return false;
+
+			Advance();
+		}
+	}
+
+	bool NextLiteral(const uint8_t*& pStart, size_t& uLength)
+	{
+		if (*m_p == '\"')
+		{
+			pStart = m_p + 1;
+			return NextString(uLength);
+		}
+
+		pStart = m_p;
+
+		while (m_p < m_pEnd)
+		{
+			uint8_t ch = *m_p;
+
+			if (ch >= 0x7F)
+				return false;
+
+			if (IsTerminatorByte(ch) || IsWhitespaceByte(ch))
+			{
+				uLength = m_p - pStart;
+				return uLength != 0;
+			}
+
+			m_p++;
+		}
+
+		return false; // non-terminated literal...
+	}
+
+	// the value starting at ch, leaves ch on the first character after it
+	bool Value(size_t uCurDepth, utf32_t& ch, Node::Type& eValue)
+	{
+		if (ch == '{' || ch == '[')
+		{
+			if (uCurDepth + 1 >= m_uMaxDepth)
+				return Fail(ErrorCode::TooDeep, m_p);
+
+			if (!Span(uCurDepth + 1, eValue))
+				return false;
+		}
+		else if (!Literal(ch, eValue))
+		{
+			return false;
+		}
+
+		if (!SkipWhitespace())
+			return false;
+
+		ch = Read();
+		return true;
+	}
+
+	bool Literal(utf32_t ch, Node::Type& eValue)
+	{
+		const uint8_t* pStart = m_p;
+		const uint8_t* z = nullptr;
+		size_t uLength = 0;
+
+		if (!NextLiteral(z, uLength))
+			return Fail(ErrorCode::UnexpectedCharacter, m_p, ch);
+
+		switch (ch)
+		{
+			case '"':
+				eValue = Node::Type::String;
+				m_Handler.OnString(z, uLength);
+				m_Handler.OnExtent(pStart, m_p);
+				return true;
+			case 't':
+			case 'f':
+			case 'n':
+				if (uLength == 4 && !memcmp(z, "true", 4))
+				{
+					eValue = Node::Type::Boolean;
+					m_Handler.OnBoolean(true);
+				}
+				else if (uLength == 5 && !memcmp(z, "false", 5))
+				{
+					eValue = Node::Type::Boolean;
+					m_Handler.OnBoolean(false);
+				}
+				else if (uLength == 4 && !memcmp(z, "null", 4))
+				{
+					eValue = Node::Type::Null;
+					m_Handler.OnNull();
+				}
+				else
+				{
+					return Fail(ErrorCode::UnexpectedCharacter, pStart, ch);
+				}
+
+				m_Handler.OnExtent(pStart, m_p);
+				return true;
+			default:
+			{
+				// a terminator follows within the buffer, which strtod never consumes
+				if (!IsPlainNumber(z, uLength))
+				{
+					char* e;
+					strtod((const char*)z, &e);
+
+					if ((const uint8_t*)e != z + uLength)
+						return Fail(ErrorCode::BadLiteral, pStart);
+				}
+
+				eValue = Node::Type::Number;
+				m_Handler.OnNumber(z, uLength);
+				m_Handler.OnExtent(pStart, m_p);
+				return true;
+			}
+		}
+	}
+
+	// past a structural character, whitespace after it is skipped without looking for the end
+	void StructureAdvance()
+	{
+		m_p++;
+		SkipWhitespaceBytes();
+	}
+
+	const uint8_t* m_p;
+	const uint8_t* m_pEnd;
+	size_t m_uMaxDepth;
+	Handler& m_Handler;
+};
+
+// runs the tokenizer over a whole document, which ends at uLength or a NUL, skipping a BOM
+template<typename Handler>
+Result Tokenize(const ParserConfig& cfg, const utf8_t* pBuffer, size_t uLength, Handler& handler)
+{
+	const uint8_t* p = (const uint8_t*)pBuffer;
+	const uint8_t* pEnd = (const uint8_t*)memchr(p, 0, uLength);
+
+	if (!pEnd)
+		pEnd = p + uLength;
+
+	// ignore BOM at the start of string
+	if (p + 3 <= pEnd && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+		p += 3;
+
+	ByteTokenizer<Handler> tokenizer(p, pEnd, cfg.m_uMaxDepth, handler);
+	Node::Type eRoot;
+
+	Result res;
+	res.m_pSource = pBuffer;
+
+	if (!tokenizer.Span(0, eRoot))
+	{
+		res.m_bSuccess = false;
+		res.m_eError = tokenizer.m_eError;
+		res.m_uOffset = (uint64_t)(tokenizer.m_pError - (const uint8_t*)pBuffer);
+		res.m_uChar = tokenizer.m_uChar;
+	}
+
+	return res;
+}
+
+}
@@ -0,0 +1,38 @@
+#include <n2ajl/Embedded.h>
+
+namespace n2ajl
+{
+
+Node EmbeddedNode::ToNode(MemoryResource* pResource) const
+{
+	switch (m_eType)
+	{
+		case Node::Type::Boolean:
+			return Node(m_bValue);
+
+		case Node::Type::Number:
+			return Node(m_dblValue);
+
+		case Node::Type::String:
+			return Node(utf8nodestring(m_szString.data(), m_szString.size(), Allocator<utf8_t>(pResource)));
+
+		case Node::Type::Array:
+		{
+			Node n = Node::Array(pResource);
+			ForEachElement([&](const EmbeddedNode& element) { n.Append(element.ToNode(pResource)); });
+			return n;
+		}
+
+		case Node::Type::Object:
+		{
+			Node n = Node::Object(pResource);
+			ForEachMember([&](std::string_view szLabel, const EmbeddedNode& member) { n.Set(Key(szLabel.data(), szLabel.size()), member.ToNode(pResource)); });
+			return n;
+		}
+
+		default:
+			return Node();
+	}
+}
+
+}
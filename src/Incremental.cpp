@@ -0,0 +1,631 @@
+#include <n2ajl/Incremental.h>
+#include "ByteTokenizer.h"
+#include <algorithm>
+
+namespace n2ajl
+{
+
+// where a value lies in the text. positions are relative to the start of the enclosing span, so an edit
+// moves only the siblings after it on each level; the root's are absolute
+struct SourceSpan
+{
+	size_t m_uStart = 0;
+	size_t m_uLength = 0;
+	size_t m_uLabel = 0;		// members: the label between its quotes, relative like m_uStart
+	size_t m_uLabelLength = 0;
+	Node::Type m_eType = Node::Type::Null;
+	bool m_bShadowed = false;	// a later member of the same object has the same label and holds the value
+	std::vector<SourceSpan> m_vChildren;
+
+	size_t GetEnd() const { return m_uStart + m_uLength; }
+	bool IsSpan() const { return m_eType == Node::Type::Array || m_eType == Node::Type::Object; }
+};
+
+// builds nodes and their spans from what ByteTokenizer reads, positions relative to m_pBase, and makes
+// the changes to the tree Node has no public call for
+struct IncrementalEditor : NullHandler
+{
+	struct Frame
+	{
+		Node m_Node;
+		SourceSpan m_Span;
+		const uint8_t* m_pLabel = nullptr;
+		size_t m_uLabelLength = 0;
+	};
+
+	IncrementalEditor(const uint8_t* pBase, MemoryResource* pResource) : m_pBase(pBase), m_pResource(pResource) {}
+
+	void OnBegin(bool bObject)
+	{
+		m_vFrames.emplace_back();
+		m_vFrames.back().m_Node = bObject ? Node::Object(m_pResource) : Node::Array(m_pResource);
+	}
+
+	void OnEnd(bool /*bObject*/, size_t /*uCount*/)
+	{
+		// a document of nothing but whitespace ends without having begun
+		if (m_vFrames.empty())
+		{
+			m_Value = Node();
+			m_Span = SourceSpan();
+			return;
+		}
+
+		m_Value = std::move(m_vFrames.back().m_Node);
+		m_Span = std::move(m_vFrames.back().m_Span);
+		m_vFrames.pop_back();
+	}
+
+	void OnLabel(const uint8_t* pLabel, size_t uLength)
+	{
+		m_vFrames.back().m_pLabel = pLabel;
+		m_vFrames.back().m_uLabelLength = uLength;
+	}
+
+	void OnString(const uint8_t* pValue, size_t uLength)
+	{
+		m_Value = Node::String(m_pResource);
+		m_Value.MutableString().assign((const utf8_t*)pValue, uLength);
+		m_Span = SourceSpan();
+	}
+
+	void OnNumber(const uint8_t* pValue, size_t /*uLength*/)
+	{
+		m_Value = Node(strtod((const char*)pValue, nullptr));
+		m_Span = SourceSpan();
+	}
+
+	void OnBoolean(bool bValue)
+	{
+		m_Value = Node(bValue);
+		m_Span = SourceSpan();
+	}
+
+	void OnNull()
+	{
+		m_Value = Node();
+		m_Span = SourceSpan();
+	}
+
+	void OnExtent(const uint8_t* pStart, const uint8_t* pEnd)
+	{
+		m_Span.m_uStart = pStart - m_pBase;
+		m_Span.m_uLength = pEnd - pStart;
+		m_Span.m_eType = m_Value.GetType();
+
+		// the children were placed before their span's start was known
+		for (SourceSpan& child : m_Span.m_vChildren)
+		{
+			child.m_uStart -= m_Span.m_uStart;
+			child.m_uLabel -= m_Span.m_uStart;
+		}
+
+		if (m_vFrames.empty())
+		{
+			m_Root = std::move(m_Value);
+			m_RootSpan = std::move(m_Span);
+			return;
+		}
+
+		Frame& parent = m_vFrames.back();
+
+		// a placeholder for a member or element that keeps its node, only its span is wanted
+		if (m_vFrames.size() == 2 && m_uSkipped < m_vSkipped.size() && m_Span.m_uStart == m_vSkipped[m_uSkipped])
+		{
+			m_uSkipped++;
+			parent.m_Span.m_vChildren.push_back(std::move(m_Span));
+			return;
+		}
+
+		if (parent.m_Node.GetType() == Node::Type::Object)
+		{
+			m_Span.m_uLabel = parent.m_pLabel - m_pBase;
+			m_Span.m_uLabelLength = parent.m_uLabelLength;
+
+			size_t uMembers = parent.m_Node.GetNumMembers();
+			parent.m_Node.Set(Key((const utf8_t*)parent.m_pLabel, parent.m_uLabelLength), std::move(m_Value));
+
+			if (parent.m_Node.GetNumMembers() == uMembers)
+				Shadow(parent.m_Span.m_vChildren, parent.m_pLabel, parent.m_uLabelLength);
+		}
+		else
+		{
+			// not Append, the tokenizer rejects a mixed array only after the element is handed over
+			Node::Elements& elements = parent.m_Node.MutableElements();
+
+			if (elements.empty())
+				parent.m_Node.m_eElementType = m_Value.GetType();
+
+			elements.push_back(std::move(m_Value));
+		}
+
+		parent.m_Span.m_vChildren.push_back(std::move(m_Span));
+	}
+
+	// the member that held the label until now, its children are still placed from m_pBase
+	void Shadow(std::vector<SourceSpan>& vMembers, const uint8_t* pLabel, size_t uLength)
+	{
+		for (auto it = vMembers.rbegin(); it != vMembers.rend(); ++it)
+		{
+			if (!it->m_bShadowed && it->m_uLabelLength == uLength && !memcmp(m_pBase + it->m_uLabel, pLabel, uLength))
+			{
+				it->m_bShadowed = true;
+				return;
+			}
+		}
+	}
+
+	static void SetElement(Node& array, size_t i, Node&& value)
+	{
+		Node::Elements& elements = array.MutableElements();
+		elements[i] = std::move(value);
+
+		if (elements.size() == 1)
+			array.m_eElementType = elements[0].GetType();
+	}
+
+	// replaces uRemoved elements at uFirst with uCount elements of source starting at uSourceFirst
+	static void ReplaceElements(Node& array, size_t uFirst, size_t uRemoved, Node& source, size_t uSourceFirst, size_t uCount)
+	{
+		Node::Elements& elements = array.MutableElements();
+		Node::Elements& from = source.MutableElements();
+
+		elements.erase(elements.begin() + uFirst, elements.begin() + uFirst + uRemoved);
+		elements.insert(elements.begin() + uFirst, std::make_move_iterator(from.begin() + uSourceFirst), std::make_move_iterator(from.begin() + uSourceFirst + uCount));
+		array.m_eElementType = elements.empty() ? Node::Type::Null : elements[0].GetType();
+	}
+
+	static void RemoveMember(Node& object, const Key& label)
+	{
+		Node::Children& children = object.MutableChildren();
+		auto it = children.find(label);
+
+		if (it != children.end())
+			children.erase(it);
+	}
+
+	const uint8_t* m_pBase;
+	MemoryResource* m_pResource;
+	std::vector<Frame> m_vFrames;
+	std::vector<size_t> m_vSkipped;	// placeholder positions, in order
+	size_t m_uSkipped = 0;
+	Node m_Value;
+	SourceSpan m_Span;
+	Node m_Root;
+	SourceSpan m_RootSpan;
+};
+
+// stands in for a member or element the edit did not reach, of the same type so arrays stay uniform
+static const char* Placeholder(Node::Type eType)
+{
+	switch (eType)
+	{
+		case Node::Type::Boolean:	return "true";
+		case Node::Type::Number:	return "0";
+		case Node::Type::String:	return "\"\"";
+		case Node::Type::Array:		return "[]";
+		case Node::Type::Object:	return "{}";
+		default:					return "null";
+	}
+}
+
+IncrementalDocument::IncrementalDocument() = default;
+IncrementalDocument::~IncrementalDocument() = default;
+
+const Node& IncrementalDocument::GetRoot() const
+{
+	static const Node s_Empty;
+	return m_bDirty ? s_Empty : m_Root;
+}
+
+Result IncrementalDocument::Parse(const ParserConfig& cfg, const utf8_t* pJson, size_t uLength, MemoryResource* pResource)
+{
+	m_Config = ParserConfig();
+	m_Config.m_uMaxDepth = cfg.m_uMaxDepth;
+	m_Config.m_bComputeHashes = cfg.m_bComputeHashes;
+	m_pResource = pResource;
+	m_szText.assign(pJson, uLength);
+	return Reparse();
+}
+
+Result IncrementalDocument::Reparse()
+{
+	IncrementalEditor editor((const uint8_t*)m_szText.data(), m_pResource);
+	Result res = Tokenize(m_Config, m_szText.c_str(), m_szText.size(), editor);
+
+	m_bDirty = false;
+
+	if (!res.m_bSuccess)
+	{
+		m_Root = Node();
+		m_pSpans.reset();
+		return res;
+	}
+
+	m_Root = std::move(editor.m_Root);
+
+	// without a root span there is nothing to narrow an edit down to
+	if (editor.m_RootSpan.IsSpan())
+		m_pSpans.reset(new SourceSpan(std::move(editor.m_RootSpan)));
+	else
+		m_pSpans.reset();
+
+	if (m_Config.m_bComputeHashes)
+		m_Root.Hash();
+
+	return res;
+}
+
+Result IncrementalDocument::Edit(size_t uOffset, size_t uRemoved, const utf8_t* pInserted, size_t uInserted)
+{
+	uOffset = std::min(uOffset, m_szText.size());
+	uRemoved = std::min(uRemoved, m_szText.size() - uOffset);
+
+	if (!m_pSpans)
+	{
+		m_szText.replace(uOffset, uRemoved, pInserted, uInserted);
+		return Reparse();
+	}
+
+	// while the text is invalid the spans describe the last valid one, so this edit joins the ones before it
+	if (m_bDirty)
+	{
+		size_t uStart = std::min(m_uDirtyOffset, uOffset);
+		size_t uEnd = std::max(m_uDirtyOffset + m_uDirtyInserted, uOffset + uRemoved);
+		size_t uDirtyEnd = m_uDirtyOffset + m_uDirtyInserted;
+
+		m_szDirtyText.insert(0, m_szText, uStart, m_uDirtyOffset - uStart);
+		m_szDirtyText.append(m_szText, uDirtyEnd, uEnd - uDirtyEnd);
+
+		m_uDirtyRemoved = uEnd - m_uDirtyInserted + m_uDirtyRemoved - uStart;
+		m_uDirtyInserted = uEnd - uStart - uRemoved + uInserted;
+		m_uDirtyOffset = uStart;
+	}
+	else
+	{
+		m_szDirtyText.assign(m_szText, uOffset, uRemoved);
+		m_uDirtyOffset = uOffset;
+		m_uDirtyRemoved = uRemoved;
+		m_uDirtyInserted = uInserted;
+	}
+
+	m_szText.replace(uOffset, uRemoved, pInserted, uInserted);
+
+	uOffset = m_uDirtyOffset;
+	uRemoved = m_uDirtyRemoved;
+	uInserted = m_uDirtyInserted;
+
+	Result res;
+	res.m_pSource = m_szText.c_str();
+
+	SourceSpan& root = *m_pSpans;
+
+	// Parse ignores whatever follows the root
+	if (uOffset >= root.GetEnd())
+	{
+		m_bDirty = false;
+		return res;
+	}
+
+	if (uOffset > root.m_uStart && uOffset + uRemoved < root.GetEnd())
+	{
+		// down to the deepest value holding the whole edit; a span only when it stays within the brackets
+		std::vector<PathStep> vPath;
+		vPath.push_back({ &root, root.m_uStart, 0 });
+
+		while (vPath.back().m_pSpan->IsSpan())
+		{
+			std::vector<SourceSpan>& vChildren = vPath.back().m_pSpan->m_vChildren;
+			size_t uStart = vPath.back().m_uStart;
+
+			auto it = std::upper_bound(vChildren.begin(), vChildren.end(), uOffset - uStart,
+									   [](size_t uAt, const SourceSpan& child) { return uAt < child.m_uStart; });
+
+			if (it == vChildren.begin())
+				break;
+
+			--it;
+
+			size_t uChildStart = uStart + it->m_uStart;
+			size_t uChildEnd = uStart + it->GetEnd();
+			bool bInside = it->IsSpan() ? uChildStart < uOffset && uOffset + uRemoved < uChildEnd
+										: uChildStart <= uOffset && uOffset + uRemoved <= uChildEnd;
+
+			if (!bInside)
+				break;
+
+			vPath.push_back({ &*it, uChildStart, (size_t)(it - vChildren.begin()) });
+		}
+
+		// widening to the parent whenever the value no longer reads as one value of its kind
+		for (; !vPath.empty(); vPath.pop_back())
+		{
+			if (Rebuild(vPath, uOffset, uRemoved, uInserted))
+			{
+				m_bDirty = false;
+
+				if (m_Config.m_bComputeHashes)
+					m_Root.Hash();
+
+				return res;
+			}
+		}
+	}
+
+	// the error has to be the one Parse reports, found without building anything
+	res = n2ajl::Validate(m_Config, m_szText.c_str(), m_szText.size());
+
+	if (res.m_bSuccess)
+		return Reparse();
+
+	m_bDirty = true;
+	return res;
+}
+
+std::string IncrementalDocument::GetOldText(size_t uAt, size_t uLength) const
+{
+	std::string szText;
+
+	for (size_t i = uAt; i < uAt + uLength; i++)
+	{
+		if (i < m_uDirtyOffset)
+			szText.push_back(m_szText[i]);
+		else if (i < m_uDirtyOffset + m_uDirtyRemoved)
+			szText.push_back(m_szDirtyText[i - m_uDirtyOffset]);
+		else
+			szText.push_back(m_szText[i - m_uDirtyRemoved + m_uDirtyInserted]);
+	}
+
+	return szText;
+}
+
+Node* IncrementalDocument::FindNode(const std::vector<PathStep>& vPath, size_t uSteps)
+{
+	Node* pNode = &m_Root;
+
+	for (size_t i = 1; i < uSteps && pNode; i++)
+	{
+		const SourceSpan& child = *vPath[i].m_pSpan;
+
+		if (child.m_bShadowed)
+			return nullptr; // not the value the tree holds
+
+		if (vPath[i - 1].m_pSpan->m_eType == Node::Type::Object)
+			pNode = pNode->Get(Key((const utf8_t*)m_szText.data() + vPath[i - 1].m_uStart + child.m_uLabel, child.m_uLabelLength));
+		else
+			pNode = pNode->At(vPath[i].m_uIndex);
+	}
+
+	return pNode;
+}
+
+bool IncrementalDocument::Rebuild(const std::vector<PathStep>& vPath, size_t uOffset, size_t uRemoved, size_t uInserted)
+{
+	SourceSpan& span = *vPath.back().m_pSpan;
+	const size_t uStart = vPath.back().m_uStart;
+	const size_t uLength = span.m_uLength + uInserted - uRemoved;
+	const size_t uLevel = vPath.size() - 1;
+	const char* pText = m_szText.data();
+
+	struct Reused
+	{
+		size_t m_uCompact;	// where the placeholder is, relative to the value like the new spans
+		size_t m_uStart;	// where the member or element now is, relative to the value
+		size_t m_uIndex;
+	};
+
+	std::vector<Reused> vReused;
+	IncrementalEditor editor(nullptr, m_pResource);
+
+	// the value wrapped in an array, each member or element before or after the edit replaced by a
+	// placeholder. a literal ending right at the edit might continue into it, so it is read again
+	std::string& szCompact = m_szScratch;
+	szCompact.assign(1, '[');
+
+	size_t uCopied = uStart;
+	size_t uSaved = 0;
+	size_t uFirst = 0; // the members or elements kept before the edit, the rest of vReused comes after it
+
+	for (size_t i = 0; span.IsSpan() && i < span.m_vChildren.size(); i++)
+	{
+		const SourceSpan& child = span.m_vChildren[i];
+		size_t uChildStart = uStart + child.m_uStart;
+		size_t uChildEnd = uChildStart + child.m_uLength;
+		bool bBefore = uChildEnd < uOffset || (uChildEnd == uOffset && (child.IsSpan() || child.m_eType == Node::Type::String));
+		bool bAfter = uChildStart > uOffset + uRemoved;
+
+		// a member keeps its node only under the label it had
+		if (span.m_eType == Node::Type::Object)
+			bAfter &= uStart + child.m_uLabel > uOffset + uRemoved;
+
+		if (!bBefore && !bAfter)
+			continue;
+
+		if (bAfter)
+			uChildStart += uInserted - uRemoved;
+		else
+			uFirst++;
+
+		szCompact.append(pText + uCopied, uChildStart - uCopied);
+		vReused.push_back({ szCompact.size() - 1, uChildStart - uStart, i });
+		editor.m_vSkipped.push_back(szCompact.size() - 1);
+		szCompact.append(Placeholder(child.m_eType));
+		uCopied = uChildStart + child.m_uLength;
+		uSaved += child.m_uLength - strlen(Placeholder(child.m_eType));
+	}
+
+	szCompact.append(pText + uCopied, uStart + uLength - uCopied);
+	szCompact.push_back(']');
+
+	// nesting is counted from the wrapper, one level above the value
+	ParserConfig cfg;
+	cfg.m_uMaxDepth = m_Config.m_uMaxDepth - uLevel + 1;
+
+	editor.m_pBase = (const uint8_t*)szCompact.data() + 1;
+
+	if (!Tokenize(cfg, szCompact.c_str(), szCompact.size(), editor).m_bSuccess || editor.m_Root.Length() != 1)
+		return false;
+
+	// the wrapper's span was placed from the character after its bracket
+	SourceSpan& result = editor.m_RootSpan.m_vChildren[0];
+	result.m_uStart += editor.m_RootSpan.m_uStart;
+
+	if (result.m_uStart != 0 || result.m_uLength != uLength - uSaved)
+		return false;
+
+	const SourceSpan* pParent = uLevel ? vPath[uLevel - 1].m_pSpan : nullptr;
+
+	if (pParent && pParent->m_eType == Node::Type::Array && pParent->m_vChildren.size() > 1 && result.m_eType != span.m_eType)
+		return false;
+
+	Node& value = *editor.m_Root.At(0);
+	std::vector<SourceSpan>& vNew = result.m_vChildren;
+
+	// each placeholder has to come back as itself, at its place
+	if (span.IsSpan())
+	{
+		if (result.m_eType != span.m_eType)
+			return false;
+
+		size_t k = 0;
+
+		for (size_t j = 0; j < vNew.size() && k < vReused.size(); j++)
+		{
+			if (vNew[j].m_uStart != vReused[k].m_uCompact)
+				continue;
+
+			const SourceSpan& child = span.m_vChildren[vReused[k].m_uIndex];
+
+			if (vNew[j].m_eType != child.m_eType || vNew[j].m_uLength != strlen(Placeholder(child.m_eType)))
+				return false;
+
+			k++;
+		}
+
+		if (k != vReused.size())
+			return false;
+
+		if (span.m_eType == Node::Type::Object)
+		{
+			bool bShadowed = value.GetNumMembers() != vNew.size() - vReused.size();
+
+			for (const SourceSpan& child : span.m_vChildren)
+				bShadowed |= child.m_bShadowed;
+
+			// which of the repeated labels holds the value is left to a parse of the whole object
+			if (bShadowed)
+				return false;
+		}
+	}
+
+	// the tree, unless the value is hidden behind a repeated label
+	bool bShadowed = span.m_bShadowed;
+
+	for (size_t i = 1; i < uLevel; i++)
+		bShadowed |= vPath[i].m_pSpan->m_bShadowed;
+
+	if (!bShadowed && !span.IsSpan())
+	{
+		Node* pParentNode = FindNode(vPath, uLevel);
+
+		if (pParent->m_eType == Node::Type::Object)
+			pParentNode->Set(Key((const utf8_t*)pText + vPath[uLevel - 1].m_uStart + span.m_uLabel, span.m_uLabelLength), std::move(value));
+		else
+			IncrementalEditor::SetElement(*pParentNode, vPath.back().m_uIndex, std::move(value));
+	}
+	else if (!bShadowed)
+	{
+		Node* pNode = FindNode(vPath, uLevel + 1);
+		size_t uLast = vReused.size() - uFirst;
+
+		if (span.m_eType == Node::Type::Array)
+		{
+			IncrementalEditor::ReplaceElements(*pNode, uFirst, span.m_vChildren.size() - uFirst - uLast, value, 0, value.Length());
+		}
+		else
+		{
+			const Node& added = value;
+			const char* pCompact = szCompact.data() + 1;
+			std::vector<std::string> vRemoved;
+
+			for (size_t i = uFirst; i < span.m_vChildren.size() - uLast; i++)
+				vRemoved.push_back(GetOldText(uStart + span.m_vChildren[i].m_uLabel, span.m_vChildren[i].m_uLabelLength));
+
+			// an added label may not repeat one of the members kept
+			for (size_t j = uFirst; j < vNew.size() - uLast; j++)
+			{
+				Key label((const utf8_t*)pCompact + vNew[j].m_uLabel, vNew[j].m_uLabelLength);
+
+				if (static_cast<const Node*>(pNode)->Get(label) && std::find(vRemoved.begin(), vRemoved.end(), std::string(label.GetData(), label.GetLength())) == vRemoved.end())
+					return false;
+			}
+
+			for (const std::string& szLabel : vRemoved)
+			{
+				Key label(szLabel.data(), szLabel.size());
+
+				if (!added.Get(label))
+					IncrementalEditor::RemoveMember(*pNode, label);
+			}
+
+			for (size_t j = uFirst; j < vNew.size() - uLast; j++)
+			{
+				Key label((const utf8_t*)pCompact + vNew[j].m_uLabel, vNew[j].m_uLabelLength);
+				pNode->Set(label, *added.Get(label)); // shares the storage, value goes away
+			}
+		}
+	}
+
+	// the spans, placed in the edited text
+	if (span.IsSpan())
+	{
+		size_t uShift = 0;
+		size_t k = 0;
+
+		for (SourceSpan& child : vNew)
+		{
+			if (k < vReused.size() && child.m_uStart == vReused[k].m_uCompact)
+			{
+				SourceSpan& old = span.m_vChildren[vReused[k].m_uIndex];
+				size_t uMoved = vReused[k].m_uStart - old.m_uStart;
+
+				old.m_uStart += uMoved;
+				old.m_uLabel += uMoved;
+				uShift += old.m_uLength - child.m_uLength;
+				child = std::move(old);
+				k++;
+			}
+			else
+			{
+				child.m_uStart += uShift;
+				child.m_uLabel += uShift;
+			}
+		}
+
+		span.m_vChildren = std::move(vNew);
+	}
+	else
+	{
+		span.m_eType = result.m_eType;
+		span.m_vChildren = std::move(vNew);
+	}
+
+	span.m_uLength = uLength;
+
+	for (size_t i = uLevel; i > 0; i--)
+	{
+		std::vector<SourceSpan>& vSiblings = vPath[i - 1].m_pSpan->m_vChildren;
+
+		for (size_t j = vPath[i].m_uIndex + 1; j < vSiblings.size(); j++)
+		{
+			vSiblings[j].m_uStart += uInserted - uRemoved;
+			vSiblings[j].m_uLabel += uInserted - uRemoved;
+		}
+
+		vPath[i - 1].m_pSpan->m_uLength += uInserted - uRemoved;
+	}
+
+	return true;
+}
+
+}
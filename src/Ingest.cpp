@@ -0,0 +1,133 @@
+#include <n2ajl/Ingest.h>
+#include <chrono>
+#include <cstdio>
+
+namespace n2ajl
+{
+
+// one file between the start of its read and its delivery
+struct IngestSlot
+{
+	std::string m_szBuffer; // keeps its capacity from file to file
+	size_t m_uIndex = 0;
+	Result m_Result;
+	Node m_Json;
+};
+
+static bool ReadFile(const char* szPath, std::string& szBuffer)
+{
+	FILE* pFile = fopen(szPath, "rb");
+	if (!pFile)
+		return false;
+
+	long iSize = fseek(pFile, 0, SEEK_END) == 0 ? ftell(pFile) : -1;
+	bool bRead = iSize >= 0 && fseek(pFile, 0, SEEK_SET) == 0;
+
+	if (bRead)
+	{
+		szBuffer.resize((size_t)iSize);
+		bRead = fread(&szBuffer[0], 1, (size_t)iSize, pFile) == (size_t)iSize;
+	}
+
+	fclose(pFile);
+	return bRead;
+}
+
+void IngestFiles(ThreadPool& pool, const IngestConfig& cfg, const std::vector<std::string>& vPaths, const IngestCallback& onFile)
+{
+	ParserConfig parserCfg = cfg.m_Parser;
+	parserCfg.m_pStats = nullptr;
+
+	std::vector<IngestSlot> vSlots(cfg.m_uBuffers ? cfg.m_uBuffers : 1);
+	std::vector<size_t> vFree;		// only touched by this thread
+	std::vector<size_t> vDone;		// parsed and waiting for delivery, guarded by mutex
+	std::mutex mutex;
+	std::condition_variable ready;
+
+	for (size_t i = vSlots.size(); i--;)
+		vFree.push_back(i);
+
+	size_t uStarted = 0;
+	size_t uDelivered = 0;
+
+	// the slot to deliver next, or vSlots.size() if it is not parsed yet; called with mutex held
+	auto FindDeliverable = [&]() -> size_t
+	{
+		for (size_t i = 0; i < vDone.size(); i++)
+		{
+			if (!cfg.m_bOrdered || vSlots[vDone[i]].m_uIndex == uDelivered)
+				return i;
+		}
+
+		return vSlots.size();
+	};
+
+	while (uDelivered < vPaths.size())
+	{
+		// every free buffer starts the next read, once none are left reading waits for deliveries
+		while (uStarted < vPaths.size() && !vFree.empty())
+		{
+			size_t uSlot = vFree.back();
+			vFree.pop_back();
+
+			IngestSlot* pSlot = &vSlots[uSlot];
+			pSlot->m_uIndex = uStarted++;
+
+			pool.Submit([pSlot, uSlot, &vPaths, &parserCfg, &vDone, &mutex, &ready]()
+			{
+				if (ReadFile(vPaths[pSlot->m_uIndex].c_str(), pSlot->m_szBuffer))
+				{
+					pSlot->m_Result = Parse(parserCfg, pSlot->m_szBuffer.c_str(), pSlot->m_Json);
+				}
+				else
+				{
+					pSlot->m_Result = Result();
+					pSlot->m_Result.m_bSuccess = false;
+					pSlot->m_Result.m_eError = ErrorCode::ReadFailed;
+					pSlot->m_Json = Node();
+				}
+
+				// notify under the lock, IngestFiles may return as soon as it sees the last slot
+				std::lock_guard<std::mutex> lock(mutex);
+				vDone.push_back(uSlot);
+				ready.notify_all();
+			});
+		}
+
+		size_t uDone = vSlots.size();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			size_t i = FindDeliverable();
+
+			if (i != vSlots.size())
+			{
+				uDone = vDone[i];
+				vDone.erase(vDone.begin() + i);
+			}
+		}
+
+		if (uDone == vSlots.size())
+		{
+			// help with queued reads and parses rather than block a thread the pool may need
+			if (pool.RunPending())
+				continue;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			ready.wait_for(lock, std::chrono::milliseconds(1), [&]() { return FindDeliverable() != vSlots.size(); });
+			continue;
+		}
+
+		IngestSlot& slot = vSlots[uDone];
+		onFile(slot.m_uIndex, slot.m_Result, slot.m_Json);
+
+		// a reusing parse overwrites the tree left in the slot, otherwise it is released now
+		if (!parserCfg.m_bReuseNodes)
+			slot.m_Json = Node();
+
+		vFree.push_back(uDone);
+		uDelivered++;
+	}
+}
+
+}
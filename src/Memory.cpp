@@ -0,0 +1,143 @@
+#include <n2ajl/Memory.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+namespace n2ajl
+{
+
+#if N2AJL_CXX17
+
+MemoryResource* GetNewDeleteResource()
+{
+	return std::pmr::new_delete_resource();
+}
+
+MemoryResource* GetDefaultResource()
+{
+	return std::pmr::get_default_resource();
+}
+
+MemoryResource* SetDefaultResource(MemoryResource* pResource)
+{
+	return std::pmr::set_default_resource(pResource);
+}
+
+#else
+
+class NewDeleteResource : public MemoryResource
+{
+protected:
+	void* do_allocate(size_t uBytes, size_t uAlignment) override
+	{
+		if (uAlignment > alignof(std::max_align_t))
+			std::abort(); // over-aligned allocations are not requested by any n2ajl container
+
+		return ::operator new(uBytes);
+	}
+
+	void do_deallocate(void* p, size_t, size_t) override
+	{
+		::operator delete(p);
+	}
+
+	bool do_is_equal(const MemoryResource& other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
+static std::atomic<MemoryResource*> s_pDefaultResource{ nullptr };
+
+MemoryResource* GetNewDeleteResource()
+{
+	static NewDeleteResource resource;
+	return &resource;
+}
+
+MemoryResource* GetDefaultResource()
+{
+	MemoryResource* pResource = s_pDefaultResource.load(std::memory_order_acquire);
+	return pResource ? pResource : GetNewDeleteResource();
+}
+
+MemoryResource* SetDefaultResource(MemoryResource* pResource)
+{
+	MemoryResource* pPrevious = s_pDefaultResource.exchange(pResource, std::memory_order_acq_rel);
+	return pPrevious ? pPrevious : GetNewDeleteResource();
+}
+
+#endif
+
+ArenaResource::ArenaResource(size_t uChunkSize, MemoryResource* pUpstream)
+{
+	m_pUpstream = pUpstream ? pUpstream : GetNewDeleteResource();
+	m_uChunkSize = uChunkSize > sizeof(Chunk) ? uChunkSize : 4096;
+}
+
+ArenaResource::~ArenaResource()
+{
+	Release();
+
+	if (m_pChunks)
+		m_pUpstream->deallocate(m_pChunks, m_pChunks->m_uSize);
+}
+
+void ArenaResource::Release()
+{
+	if (!m_pChunks)
+		return;
+
+	// free everything but the oldest chunk, which is at the end of the list
+	while (m_pChunks->m_pNext)
+	{
+		Chunk* pNext = m_pChunks->m_pNext;
+		m_pUpstream->deallocate(m_pChunks, m_pChunks->m_uSize);
+		m_pChunks = pNext;
+	}
+
+	m_pCursor = (char*)(m_pChunks + 1);
+	m_pEnd = (char*)m_pChunks + m_pChunks->m_uSize;
+	m_uAllocated = 0;
+}
+
+void* ArenaResource::do_allocate(size_t uBytes, size_t uAlignment)
+{
+	uintptr_t uCursor = ((uintptr_t)m_pCursor + uAlignment - 1) & ~(uintptr_t)(uAlignment - 1);
+
+	if (!m_pCursor || uCursor + uBytes > (uintptr_t)m_pEnd)
+	{
+		// oversized requests get a chunk of their own
+		size_t uSize = sizeof(Chunk) + uBytes + uAlignment;
+		if (uSize < m_uChunkSize)
+			uSize = m_uChunkSize;
+
+		Chunk* pChunk = (Chunk*)m_pUpstream->allocate(uSize, alignof(std::max_align_t));
+		pChunk->m_pNext = m_pChunks;
+		pChunk->m_uSize = uSize;
+
+		m_pChunks = pChunk;
+		m_pCursor = (char*)(pChunk + 1);
+		m_pEnd = (char*)pChunk + uSize;
+
+		uCursor = ((uintptr_t)m_pCursor + uAlignment - 1) & ~(uintptr_t)(uAlignment - 1);
+	}
+
+	m_pCursor = (char*)(uCursor + uBytes);
+	m_uAllocated += uBytes;
+
+	return (void*)uCursor;
+}
+
+void ArenaResource::do_deallocate(void*, size_t, size_t)
+{
+	// memory is only returned by Release
+}
+
+bool ArenaResource::do_is_equal(const MemoryResource& other) const noexcept
+{
+	return this == &other;
+}
+
+}
@@ -1,16 +1,111 @@
 #include <n2ajl/Node.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
 
+#ifdef _MSC_VER
 #define ON_TYPE_CHECK_FAIL { __debugbreak(); std::abort(); }
+#else
+#define ON_TYPE_CHECK_FAIL { std::abort(); }
+#endif
 #define ENSURE_OBJECT { if (m_eType != Type::Object) ON_TYPE_CHECK_FAIL }
 #define ENSURE_ARRAY { if (m_eType != Type::Array) ON_TYPE_CHECK_FAIL }
 
 namespace n2ajl
 {
 
-Node::Node()
+// allocation and reference counting of the storage shared between copies
+struct NodeStorage
 {
-	memset(this, 0, sizeof(Node));
-}
+	template<typename T, typename... Args>
+	static Node::Shared<T>* Create(MemoryResource* pResource, Args&&... args)
+	{
+		Allocator<Node::Shared<T>> alloc(pResource);
+		return new(alloc.allocate(1)) Node::Shared<T>(std::forward<Args>(args)...);
+	}
+
+	template<typename T>
+	static void Acquire(Node::Shared<T>* p)
+	{
+		p->m_uRefs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	template<typename T>
+	static void Release(Node::Shared<T>* p)
+	{
+		if (p->m_uRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Free(p);
+	}
+
+	static void Release(Node::Shared<Node::Elements>* p)
+	{
+		if (p->m_uRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Destroy(p->m_uHash, reinterpret_cast<uintptr_t>(p) | s_uArrayTag);
+	}
+
+	static void Release(Node::Shared<Node::Children>* p)
+	{
+		if (p->m_uRefs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			Destroy(p->m_uHash, reinterpret_cast<uintptr_t>(p));
+	}
+
+	template<typename T>
+	static void Free(Node::Shared<T>* p)
+	{
+		Allocator<Node::Shared<T>> alloc(p->m_Value.get_allocator().GetResource());
+		p->~Shared();
+		alloc.deallocate(p, 1);
+	}
+
+	// containers whose last reference is gone, linked through their hashes with bit 0 set for arrays
+	static const uintptr_t s_uArrayTag = 1;
+
+	static void Destroy(std::atomic<uint64_t>& uLink, uintptr_t uBlock);
+
+	template<typename T>
+	static bool IsShared(const Node::Shared<T>* p)
+	{
+		return p->m_uRefs.load(std::memory_order_acquire) != 1;
+	}
+
+	// only decides when both hashes are already cached
+	template<typename T>
+	static bool HashesDiffer(const Node::Shared<T>* a, const Node::Shared<T>* b)
+	{
+		uint64_t uA = a->m_uHash.load(std::memory_order_relaxed);
+		uint64_t uB = b->m_uHash.load(std::memory_order_relaxed);
+
+		return uA && uB && uA != uB;
+	}
+
+	// clones one level (children are shared by the copy) when other nodes still reference p
+	template<typename T>
+	static T& Unshare(Node::Shared<T>*& p)
+	{
+		if (IsShared(p))
+		{
+			Node::Shared<T>* pCopy = Create<T>(p->m_Value.get_allocator().GetResource(), p->m_Value);
+			Release(p);
+			p = pCopy;
+		}
+
+		p->m_uHash.store(0, std::memory_order_relaxed);
+		return p->m_Value;
+	}
+
+	// blocks referenced by more than one node are remembered so they are only counted the first time
+	template<typename T>
+	static bool FirstVisit(const Node::Shared<T>* p, std::unordered_set<const void*>& seen)
+	{
+		return !IsShared(p) || seen.insert(p).second;
+	}
+
+	static void AddUsage(const Node& n, MemoryUsage& usage, std::unordered_set<const void*>& seen);
+	static void BuildIndexes(const Node& n, std::unordered_set<const void*>& seen);
+};
+
+Node::Node() = default;
 
 Node::~Node()
 {
@@ -29,10 +124,9 @@ Node::Node(double dblValue)
 	m_dblValue = dblValue;
 }
 
-Node::Node(const utf8_t* szValue)
+Node::Node(const utf8_t* szValue, MemoryResource* pResource)
 {
-	m_eType = Type::String;
-	new(&m_szValue) decltype(m_szValue);
+	Init(Type::String, pResource);
 
 	// decode the real length of the given Unicode string
 	size_t uByteLength = 0;
@@ -45,40 +139,41 @@ Node::Node(const utf8_t* szValue)
 		iter.Advance();
 	}
 
-	m_szValue.resize(uByteLength);
-	memcpy(const_cast<char*>(m_szValue.data()), szValue, uByteLength);
+	m_pString->m_Value.assign(szValue, uByteLength);
+}
+
+Node::Node(const utf8string& szValue, MemoryResource* pResource)
+{
+	m_eType = Type::String;
+	m_pString = NodeStorage::Create<utf8nodestring>(pResource, szValue.data(), szValue.size(), Allocator<utf8_t>(pResource));
 }
 
-Node::Node(const utf8string& szValue)
+Node::Node(const utf8nodestring& szValue)
 {
 	m_eType = Type::String;
-	new(&m_szValue) decltype(m_szValue);
-	m_szValue = szValue;
+	m_pString = NodeStorage::Create<utf8nodestring>(szValue.get_allocator().GetResource(), szValue);
 }
 
-Node Node::Object()
+Node Node::Object(MemoryResource* pResource)
 {
 	Node n;
-	n.m_eType = Node::Type::Object;
-	new(&n.m_mChildren) decltype(m_mChildren)();
+	n.Init(Type::Object, pResource);
 
 	return n;
 }
 
-Node Node::Array()
+Node Node::Array(MemoryResource* pResource)
 {
 	Node n;
-	n.m_eType = Node::Type::Array;
-	new(&n.m_vElements) decltype(m_vElements)();
+	n.Init(Type::Array, pResource);
 
 	return n;
 }
 
-Node Node::String()
+Node Node::String(MemoryResource* pResource)
 {
 	Node n;
-	n.m_eType = Node::Type::String;
-	new(&n.m_szValue) decltype(m_szValue)();
+	n.Init(Type::String, pResource);
 
 	return n;
 }
@@ -99,23 +194,30 @@ double Node::GetNumber() const
 	return m_dblValue;
 }
 
-const utf8string& Node::GetString() const
+const utf8nodestring& Node::GetString() const
 {
 	if (m_eType != Type::String)
 		ON_TYPE_CHECK_FAIL
 
-	return m_szValue;
+	return m_pString->m_Value;
 }
 
 Node& Node::operator=(const Node& RHS)
 {
-	// destroy our own non-trivially copyable members
-	Reset();
+	if (this == &RHS)
+		return *this;
 
+	// take the reference first, RHS may live inside the subtree we are about to release
+	return operator=(Node(RHS));
+}
+
+Node::Node(const Node& RHS) noexcept
+{
 	// copy node type
 	m_eType = RHS.m_eType;
+	m_eElementType = RHS.m_eElementType;
 
-	// initialize union members
+	// share the string or container
 	switch (m_eType)
 	{
 		case Type::Boolean:
@@ -125,143 +227,448 @@ Node& Node::operator=(const Node& RHS)
 			m_dblValue = RHS.m_dblValue;
 			break;
 		case Type::String:
-			new(&m_szValue) decltype(m_szValue);
-			m_szValue = RHS.m_szValue;
+			m_pString = RHS.m_pString;
+			NodeStorage::Acquire(m_pString);
 			break;
 		case Type::Array:
-			new(&m_vElements) decltype(m_vElements);
-			m_vElements = RHS.m_vElements;
+			m_pElements = RHS.m_pElements;
+			NodeStorage::Acquire(m_pElements);
 			break;
 		case Type::Object:
-			new(&m_mChildren) decltype(m_mChildren);
-			m_mChildren = RHS.m_mChildren;
+			m_pChildren = RHS.m_pChildren;
+			NodeStorage::Acquire(m_pChildren);
 			break;
 		default:
 			break;
 	}
+}
+
+Node& Node::operator=(Node&& RHS) noexcept
+{
+	if (this == &RHS)
+		return *this;
+
+	// detach RHS before releasing our own storage, which may own it
+	Node moved(std::move(RHS));
+
+	Reset();
+	memcpy((void*)this, (const void*)&moved, sizeof(Node));
+	memset((void*)&moved, 0, sizeof(Node));
 
 	return *this;
 }
 
-Node::Node(const Node& RHS) noexcept
+Node::Node(Node&& RHS) noexcept
 {
-	memset(this, 0, sizeof(Node));
-	operator=(RHS);
+	// storage is owned through a single pointer, moving is a plain transfer
+	memcpy((void*)this, (const void*)&RHS, sizeof(Node));
+	memset((void*)&RHS, 0, sizeof(Node));
+	m_bTouched = false;
 }
 
-Node::Node(Node&& RHS) noexcept
+MemoryResource* Node::GetResource() const
 {
-	// destroy our own non-trivially copyable members
-	Reset();
+	switch (m_eType)
+	{
+		case Type::String:
+			return m_pString->m_Value.get_allocator().GetResource();
+		case Type::Array:
+			return m_pElements->m_Value.get_allocator().GetResource();
+		case Type::Object:
+			return m_pChildren->m_Value.get_allocator().GetResource();
+		default:
+			return nullptr;
+	}
+}
 
-	// copy node type
-	m_eType = RHS.m_eType;
+bool Node::IsShared() const
+{
+	switch (m_eType)
+	{
+		case Type::String:
+			return NodeStorage::IsShared(m_pString);
+		case Type::Array:
+			return NodeStorage::IsShared(m_pElements);
+		case Type::Object:
+			return NodeStorage::IsShared(m_pChildren);
+		default:
+			return false;
+	}
+}
 
-	// initialize union members
+bool Node::IsHashed() const
+{
 	switch (m_eType)
 	{
-		case Type::Boolean:
-			m_bValue = RHS.m_bValue;
-			break;
-		case Type::Number:
-			m_dblValue = RHS.m_dblValue;
-			break;
 		case Type::String:
-			new(&m_szValue) decltype(m_szValue);
-			m_szValue = std::move(RHS.m_szValue);
-			break;
+			return m_pString->m_uHash.load(std::memory_order_relaxed) != 0;
 		case Type::Array:
-			new(&m_vElements) decltype(m_vElements);
-			m_vElements = std::move(RHS.m_vElements);
-			break;
+			return m_pElements->m_uHash.load(std::memory_order_relaxed) != 0;
 		case Type::Object:
-			new(&m_mChildren) decltype(m_mChildren);
-			m_mChildren = std::move(RHS.m_mChildren);
+			return m_pChildren->m_uHash.load(std::memory_order_relaxed) != 0;
+		default:
+			return true;
+	}
+}
+
+utf8nodestring& Node::MutableString()
+{
+	return NodeStorage::Unshare(m_pString);
+}
+
+Node::Elements& Node::MutableElements()
+{
+	return NodeStorage::Unshare(m_pElements);
+}
+
+Node::Children& Node::MutableChildren()
+{
+	Children& children = NodeStorage::Unshare(m_pChildren);
+	children.DropIndex();
+	return children;
+}
+
+// object funcs
+// non-const access may change the subtree, directly or through a returned child, so it always unshares
+
+// below this many members a map lookup is cheaper than building an index
+static const size_t s_uIndexedMembers = 8;
+
+struct Node::LabelIndex
+{
+	struct Slot
+	{
+		uint64_t m_uHash;
+		const Children::value_type* m_pMember; // null for an empty slot
+	};
+
+	explicit LabelIndex(MemoryResource* pResource) : m_vSlots(Allocator<Slot>(pResource)) {}
+
+	std::vector<Slot, Allocator<Slot>> m_vSlots; // a power of two, at most half full
+};
+
+void Node::Children::DropIndex()
+{
+	LabelIndex* pIndex = m_pIndex.exchange(nullptr, std::memory_order_acquire);
+	if (!pIndex)
+		return;
+
+	Allocator<LabelIndex> alloc(get_allocator().GetResource());
+	pIndex->~LabelIndex();
+	alloc.deallocate(pIndex, 1);
+}
+
+// containers waiting to be freed by this thread, and whether a Destroy further up the stack frees them
+struct PendingBlocks
+{
+	uintptr_t m_uFirst = 0;
+	bool m_bFreeing = false;
+};
+
+static thread_local PendingBlocks t_Pending;
+
+// frees a tree of any depth in constant stack space. freeing a container releases its children, and each
+// child container losing its last reference there is queued here instead of being freed inside its parent.
+// the queue is linked through the hashes, which nothing reads once the last reference is gone
+void NodeStorage::Destroy(std::atomic<uint64_t>& uLink, uintptr_t uBlock)
+{
+	PendingBlocks& pending = t_Pending;
+
+	uLink.store(pending.m_uFirst, std::memory_order_relaxed);
+	pending.m_uFirst = uBlock;
+
+	if (pending.m_bFreeing)
+		return;
+
+	pending.m_bFreeing = true;
+
+	while (pending.m_uFirst)
+	{
+		uBlock = pending.m_uFirst;
+
+		if (uBlock & s_uArrayTag)
+		{
+			auto* p = reinterpret_cast<Node::Shared<Node::Elements>*>(uBlock & ~s_uArrayTag);
+			pending.m_uFirst = (uintptr_t)p->m_uHash.load(std::memory_order_relaxed);
+			Free(p);
+		}
+		else
+		{
+			auto* p = reinterpret_cast<Node::Shared<Node::Children>*>(uBlock);
+			pending.m_uFirst = (uintptr_t)p->m_uHash.load(std::memory_order_relaxed);
+			Free(p);
+		}
+	}
+
+	pending.m_bFreeing = false;
+}
+
+void NodeStorage::AddUsage(const Node& n, MemoryUsage& usage, std::unordered_set<const void*>& seen)
+{
+	switch (n.m_eType)
+	{
+		case Node::Type::String:
+			if (FirstVisit(n.m_pString, seen))
+			{
+				usage.m_uNodes += Node::BlockBytes(Node::Type::String);
+				usage.m_uStrings += Node::HeapBytes(n.m_pString->m_Value);
+			}
+			break;
+		case Node::Type::Array:
+			if (FirstVisit(n.m_pElements, seen))
+			{
+				usage.m_uNodes += Node::BlockBytes(Node::Type::Array);
+				usage.m_uContainers += n.m_pElements->m_Value.capacity() * sizeof(Node);
+
+				for (const Node& element : n.m_pElements->m_Value)
+					AddUsage(element, usage, seen);
+			}
+			break;
+		case Node::Type::Object:
+			if (FirstVisit(n.m_pChildren, seen))
+			{
+				const Node::Children& children = n.m_pChildren->m_Value;
+				const Node::LabelIndex* pIndex = children.m_pIndex.load(std::memory_order_acquire);
+
+				usage.m_uNodes += Node::BlockBytes(Node::Type::Object);
+				usage.m_uContainers += children.size() * Node::MemberBytes();
+
+				if (pIndex)
+					usage.m_uContainers += sizeof(*pIndex) + pIndex->m_vSlots.capacity() * sizeof(pIndex->m_vSlots[0]);
+
+				for (const auto& member : children)
+				{
+					usage.m_uStrings += Node::HeapBytes(member.first);
+					AddUsage(member.second, usage, seen);
+				}
+			}
 			break;
 		default:
 			break;
 	}
+}
 
-	// invalidate other node
-	RHS.Reset();
+void NodeStorage::BuildIndexes(const Node& n, std::unordered_set<const void*>& seen)
+{
+	if (n.m_eType == Node::Type::Array && FirstVisit(n.m_pElements, seen))
+	{
+		for (const Node& element : n.m_pElements->m_Value)
+			BuildIndexes(element, seen);
+	}
+	else if (n.m_eType == Node::Type::Object && FirstVisit(n.m_pChildren, seen))
+	{
+		const Node::Children& children = n.m_pChildren->m_Value;
+
+		if (children.size() >= s_uIndexedMembers)
+			Node::GetIndex(children);
+
+		for (const auto& member : children)
+			BuildIndexes(member.second, seen);
+	}
 }
 
-// object funcs
+void Node::BuildIndexes() const
+{
+	std::unordered_set<const void*> seen;
+	NodeStorage::BuildIndexes(*this, seen);
+}
+
+MemoryUsage Node::GetMemoryUsage() const
+{
+	MemoryUsage usage;
+	std::unordered_set<const void*> seen;
+
+	NodeStorage::AddUsage(*this, usage, seen);
+	return usage;
+}
+
+size_t Node::BlockBytes(Type eType)
+{
+	switch (eType)
+	{
+		case Type::String:
+			return sizeof(Shared<utf8nodestring>);
+		case Type::Array:
+			return sizeof(Shared<Elements>);
+		case Type::Object:
+			return sizeof(Shared<Children>);
+		default:
+			return 0;
+	}
+}
+
+size_t Node::HeapBytes(const utf8nodestring& szValue)
+{
+	static const size_t s_uInline = utf8nodestring().capacity();
+	return szValue.capacity() > s_uInline ? szValue.capacity() + 1 : 0;
+}
+
+size_t Node::MemberBytes()
+{
+	// a red-black tree node: colour and three links ahead of the value in the common implementations
+	return sizeof(Members::value_type) + 4 * sizeof(void*);
+}
+
+const Node::LabelIndex* Node::GetIndex(const Children& children)
+{
+	const LabelIndex* pIndex = children.m_pIndex.load(std::memory_order_acquire);
+
+	if (!pIndex)
+	{
+		MemoryResource* pResource = children.get_allocator().GetResource();
+		Allocator<LabelIndex> alloc(pResource);
+		LabelIndex* pBuilt = new(alloc.allocate(1)) LabelIndex(pResource);
+
+		size_t uSlots = 1;
+		while (uSlots < children.size() * 2)
+			uSlots <<= 1;
+
+		pBuilt->m_vSlots.resize(uSlots, LabelIndex::Slot { 0, nullptr });
+
+		for (const auto& member : children)
+		{
+			uint64_t uHash = Key(member.first).GetHash();
+			size_t i = (size_t)uHash & (uSlots - 1);
+
+			while (pBuilt->m_vSlots[i].m_pMember)
+				i = (i + 1) & (uSlots - 1);
+
+			pBuilt->m_vSlots[i] = { uHash, &member };
+		}
 
-Node* Node::Get(const utf8string& szLabel)
+		// const lookups may race to build it, the loser frees its own and uses the one published first
+		LabelIndex* pExpected = nullptr;
+
+		if (children.m_pIndex.compare_exchange_strong(pExpected, pBuilt, std::memory_order_acq_rel))
+		{
+			pIndex = pBuilt;
+		}
+		else
+		{
+			pBuilt->~LabelIndex();
+			alloc.deallocate(pBuilt, 1);
+			pIndex = pExpected;
+		}
+	}
+
+	return pIndex;
+}
+
+const Node* Node::FindMember(const Children& children, const Key& label)
+{
+	if (children.size() < s_uIndexedMembers)
+	{
+		auto it = children.find(label);
+		return it != children.end() ? &it->second : nullptr;
+	}
+
+	const auto& vSlots = GetIndex(children)->m_vSlots;
+	size_t uMask = vSlots.size() - 1;
+
+	for (size_t i = (size_t)label.GetHash() & uMask; vSlots[i].m_pMember; i = (i + 1) & uMask)
+	{
+		const utf8nodestring& szLabel = vSlots[i].m_pMember->first;
+
+		if (vSlots[i].m_uHash == label.GetHash() && szLabel.size() == label.GetLength() &&
+			!memcmp(szLabel.data(), label.GetData(), label.GetLength()))
+		{
+			return &vSlots[i].m_pMember->second;
+		}
+	}
+
+	return nullptr;
+}
+
+Node* Node::Get(const Key& label)
 {
 	ENSURE_OBJECT
-	auto it = m_mChildren.find(szLabel);
-	return it != m_mChildren.end() ? &it->second : nullptr;
+	// members stay where they are, so an index built earlier is still good
+	Children& children = NodeStorage::Unshare(m_pChildren);
+	return const_cast<Node*>(FindMember(children, label));
 }
 
-const Node* Node::Get(const utf8string& szLabel) const
+const Node* Node::Get(const Key& label) const
 {
 	ENSURE_OBJECT
-	auto it = m_mChildren.find(szLabel);
-	return it != m_mChildren.end() ? &it->second : nullptr;
+	return FindMember(m_pChildren->m_Value, label);
 }
 
-void Node::Set(const utf8string& szLabel, const Node& n)
+void Node::Set(const Key& label, const Node& n)
+{
+	Set(label, Node(n));
+}
+
+void Node::Set(const Key& label, Node&& n)
 {
 	ENSURE_OBJECT
-	m_mChildren[szLabel] = n;
+	Children& children = MutableChildren();
+	auto it = children.lower_bound(label);
+
+	if (it == children.end() || LabelLess()(label, it->first))
+	{
+		it = children.emplace_hint(it, std::piecewise_construct,
+								   std::forward_as_tuple(label.GetData(), label.GetLength(), children.get_allocator()),
+								   std::forward_as_tuple());
+	}
+
+	it->second = std::move(n);
 }
 
-bool Node::GetOrDefault(const utf8string& szLabel, bool bDefault) const
+bool Node::GetOrDefault(const Key& label, bool bDefault) const
 {
-	const Node* n = Get(szLabel);
+	const Node* n = Get(label);
 	if (!n || n->m_eType != Type::Boolean)
 		return bDefault;
 
 	return n->GetBool();
 }
 
-double Node::GetOrDefault(const utf8string& szLabel, double dblDefault) const
+double Node::GetOrDefault(const Key& label, double dblDefault) const
 {
-	const Node* n = Get(szLabel);
+	const Node* n = Get(label);
 	if (!n || n->m_eType != Type::Number)
 		return dblDefault;
 
 	return n->GetNumber();
 }
 
-utf8string Node::GetOrDefault(const utf8string& szLabel, const utf8string& szDefault) const
+utf8string Node::GetOrDefault(const Key& label, const utf8string& szDefault) const
 {
-	const Node* n = Get(szLabel);
-	if (!n || n->m_eType != Type::Boolean)
+	const Node* n = Get(label);
+	if (!n || n->m_eType != Type::String)
 		return szDefault;
 
-	return n->GetString();
+	return utf8string(n->GetString().data(), n->GetString().size());
 }
 
-utf8string Node::GetOrDefault(const utf8string& szLabel, const utf8_t* szDefault) const
+utf8string Node::GetOrDefault(const Key& label, const utf8_t* szDefault) const
 {
-	const Node* n = Get(szLabel);
-	if (!n || n->m_eType != Type::Boolean)
+	const Node* n = Get(label);
+	if (!n || n->m_eType != Type::String)
 		return szDefault;
 
-	return n->GetString();
+	return utf8string(n->GetString().data(), n->GetString().size());
 }
 
-void Node::ForEachMember(const std::function<void(const std::string&, Node&)>& callback)
+Node::MemberRange Node::members()
 {
 	ENSURE_OBJECT
-	for (auto it : m_mChildren)
-		callback(it.first, it.second);
+	// members can be changed but not added or removed, so the index stays
+	Children& children = NodeStorage::Unshare(m_pChildren);
+	return MemberRange(children.begin(), children.end());
 }
 
-void Node::ForEachMember(const std::function<void(const std::string&, const Node&)>& callback) const
+Node::ConstMemberRange Node::members() const
 {
 	ENSURE_OBJECT
-	for (auto it : m_mChildren)
-		callback(it.first, it.second);
+	const Children& children = m_pChildren->m_Value;
+	return ConstMemberRange(children.begin(), children.end());
 }
 
 size_t Node::GetNumMembers() const
 {
 	ENSURE_OBJECT
-	return m_mChildren.size();
+	return m_pChildren->m_Value.size();
 }
 
 // array funcs
@@ -269,19 +676,44 @@ size_t Node::GetNumMembers() const
 size_t Node::Length() const
 {
 	ENSURE_ARRAY
-	return m_vElements.size();
+	return m_pElements->m_Value.size();
+}
+
+size_t Node::Capacity() const
+{
+	ENSURE_ARRAY
+	return m_pElements->m_Value.capacity();
 }
 
 Node* Node::At(size_t i)
 {
 	ENSURE_ARRAY
-	return &m_vElements[i];
+	return &MutableElements()[i];
 }
 
 void Node::Append(const Node& n)
 {
 	ENSURE_ARRAY
-	if (m_vElements.empty())
+	Elements& elements = MutableElements();
+
+	if (elements.empty())
+		m_eElementType = n.m_eType;
+
+	if (n.m_eType != m_eElementType)
+	{
+		// incorrect element type being appended (not uniform)
+		std::abort();
+	}
+
+	elements.push_back(n);
+}
+
+void Node::Append(Node&& n)
+{
+	ENSURE_ARRAY
+	Elements& elements = MutableElements();
+
+	if (elements.empty())
 		m_eElementType = n.m_eType;
 
 	if (n.m_eType != m_eElementType)
@@ -290,21 +722,23 @@ void Node::Append(const Node& n)
 		std::abort();
 	}
 
-	m_vElements.push_back(n);
+	elements.push_back(std::move(n));
 }
 
 void Node::Insert(size_t i, const Node& n)
 {
 	ENSURE_ARRAY
-	m_vElements.insert(m_vElements.begin() + i, n);
+	Elements& elements = MutableElements();
+	elements.insert(elements.begin() + i, n);
 }
 
 void Node::Remove(size_t i)
 {
 	ENSURE_ARRAY
-	m_vElements.erase(m_vElements.begin() + i);
+	Elements& elements = MutableElements();
+	elements.erase(elements.begin() + i);
 
-	if (m_vElements.empty())
+	if (elements.empty())
 		m_eElementType = Type::Null; // contains nothing
 }
 
@@ -314,18 +748,324 @@ Node::Type Node::GetElementType() const
 	return m_eElementType;
 }
 
-void Node::ForEachElement(const std::function<void(Node&)>& callback)
+Node::ElementRange Node::elements()
 {
 	ENSURE_ARRAY
-	for (Node& n : m_vElements)
-		callback(n);
+	Elements& elements = MutableElements();
+	return ElementRange(elements.begin(), elements.end());
 }
 
-void Node::ForEachElement(const std::function<void(const Node&)>& callback) const
+Node::ConstElementRange Node::elements() const
 {
 	ENSURE_ARRAY
-	for (const Node& n : m_vElements)
-		callback(n);
+	const Elements& elements = m_pElements->m_Value;
+	return ConstElementRange(elements.begin(), elements.end());
+}
+
+// hashing
+
+static inline uint64_t MixHash(uint64_t h)
+{
+	// splitmix64 finalizer
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ull;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBull;
+	h ^= h >> 31;
+	return h;
+}
+
+static inline uint64_t CombineHash(uint64_t h, uint64_t v)
+{
+	return MixHash(h ^ (v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2)));
+}
+
+// MurmurHash64A
+static uint64_t HashBytes(const utf8_t* pData, size_t uLength, uint64_t uSeed)
+{
+	const uint64_t m = 0xC6A4A7935BD1E995ull;
+	const int r = 47;
+
+	uint64_t h = uSeed ^ (uLength * m);
+
+	const uint8_t* p = (const uint8_t*)pData;
+	const uint8_t* end = p + (uLength & ~(size_t)7);
+
+	for (; p != end; p += 8)
+	{
+		uint64_t k;
+		memcpy(&k, p, sizeof(k));
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch (uLength & 7)
+	{
+		case 7: h ^= (uint64_t)p[6] << 48; // fallthrough
+		case 6: h ^= (uint64_t)p[5] << 40; // fallthrough
+		case 5: h ^= (uint64_t)p[4] << 32; // fallthrough
+		case 4: h ^= (uint64_t)p[3] << 24; // fallthrough
+		case 3: h ^= (uint64_t)p[2] << 16; // fallthrough
+		case 2: h ^= (uint64_t)p[1] << 8; // fallthrough
+		case 1: h ^= (uint64_t)p[0];
+			h *= m;
+			break;
+		default: break;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+uint64_t Node::Hash() const
+{
+	uint64_t h = MixHash((uint64_t)m_eType + 1);
+
+	// scalars are hashed on the spot, everything else caches in its shared storage
+	std::atomic<uint64_t>* pCache = nullptr;
+
+	switch (m_eType)
+	{
+		case Type::Boolean:
+			return CombineHash(h, m_bValue);
+		case Type::Number:
+		{
+			double dblValue = m_dblValue == 0.0 ? 0.0 : m_dblValue; // -0 equals 0
+			uint64_t uBits;
+			memcpy(&uBits, &dblValue, sizeof(uBits));
+
+			return CombineHash(h, uBits);
+		}
+		case Type::String:
+			pCache = &m_pString->m_uHash;
+			break;
+		case Type::Array:
+			pCache = &m_pElements->m_uHash;
+			break;
+		case Type::Object:
+			pCache = &m_pChildren->m_uHash;
+			break;
+		default:
+			return h;
+	}
+
+	// racing threads compute the same value, so a relaxed cache is enough
+	if (uint64_t uCached = pCache->load(std::memory_order_relaxed))
+		return uCached;
+
+	if (m_eType == Type::String)
+	{
+		const utf8nodestring& szValue = m_pString->m_Value;
+		h = CombineHash(h, HashBytes(szValue.data(), szValue.size(), 0));
+	}
+	else if (m_eType == Type::Array)
+	{
+		for (const Node& n : m_pElements->m_Value)
+			h = CombineHash(h, n.Hash());
+	}
+	else
+	{
+		// members are ordered by label, so equal objects always combine in the same order
+		for (const auto& it : m_pChildren->m_Value)
+			h = CombineHash(h, CombineHash(HashBytes(it.first.data(), it.first.size(), 0), it.second.Hash()));
+	}
+
+	h = h ? h : 1; // zero means not computed
+	pCache->store(h, std::memory_order_relaxed);
+
+	return h;
+}
+
+bool Node::Equals(const Node& other) const
+{
+	if (this == &other)
+		return true;
+
+	if (m_eType != other.m_eType)
+		return false;
+
+	switch (m_eType)
+	{
+		case Type::Boolean:
+			return m_bValue == other.m_bValue;
+		case Type::Number:
+			return m_dblValue == other.m_dblValue;
+		case Type::String:
+		{
+			if (m_pString == other.m_pString)
+				return true;
+
+			if (NodeStorage::HashesDiffer(m_pString, other.m_pString))
+				return false;
+
+			return m_pString->m_Value == other.m_pString->m_Value;
+		}
+		case Type::Array:
+		{
+			if (m_pElements == other.m_pElements)
+				return true;
+
+			if (NodeStorage::HashesDiffer(m_pElements, other.m_pElements))
+				return false;
+
+			const Elements& a = m_pElements->m_Value;
+			const Elements& b = other.m_pElements->m_Value;
+
+			if (a.size() != b.size())
+				return false;
+
+			for (size_t i = 0; i < a.size(); i++)
+			{
+				if (!a[i].Equals(b[i]))
+					return false;
+			}
+
+			return true;
+		}
+		case Type::Object:
+		{
+			if (m_pChildren == other.m_pChildren)
+				return true;
+
+			if (NodeStorage::HashesDiffer(m_pChildren, other.m_pChildren))
+				return false;
+
+			const Children& a = m_pChildren->m_Value;
+			const Children& b = other.m_pChildren->m_Value;
+
+			if (a.size() != b.size())
+				return false;
+
+			for (auto itA = a.begin(), itB = b.begin(); itA != a.end(); ++itA, ++itB)
+			{
+				if (itA->first != itB->first || !itA->second.Equals(itB->second))
+					return false;
+			}
+
+			return true;
+		}
+		default:
+			return true;
+	}
+}
+
+static void AppendPointerToken(utf8string& szPath, const utf8_t* pToken, size_t uLength)
+{
+	szPath += '/';
+
+	for (size_t i = 0; i < uLength; i++)
+	{
+		if (pToken[i] == '~')
+			szPath += "~0";
+		else if (pToken[i] == '/')
+			szPath += "~1";
+		else
+			szPath += pToken[i];
+	}
+}
+
+struct NodeDiff
+{
+	const DiffCallback& m_Callback;
+	bool m_bExact;
+	size_t m_uVisited;
+	utf8string m_szPath;
+
+	bool Same(const Node& lhs, const Node& rhs) const
+	{
+		return lhs.Hash() == rhs.Hash() && (!m_bExact || lhs.Equals(rhs));
+	}
+
+	// lhs and rhs are known to differ, or could not be told apart by their hashes alone
+	void Walk(const Node& lhs, const Node& rhs)
+	{
+		m_uVisited++;
+
+		if (lhs.m_eType != rhs.m_eType || (lhs.m_eType != Node::Type::Array && lhs.m_eType != Node::Type::Object))
+		{
+			m_Callback(m_szPath, &lhs, &rhs);
+			return;
+		}
+
+		size_t uPathLength = m_szPath.size();
+
+		if (lhs.m_eType == Node::Type::Array)
+		{
+			const Node::Elements& a = lhs.m_pElements->m_Value;
+			const Node::Elements& b = rhs.m_pElements->m_Value;
+
+			for (size_t i = 0; i < a.size() || i < b.size(); i++)
+			{
+				bool bBoth = i < a.size() && i < b.size();
+
+				// the path is only built for what differs
+				if (bBoth && Same(a[i], b[i]))
+					continue;
+
+				char szIndex[24];
+				int iLength = snprintf(szIndex, sizeof(szIndex), "%zu", i);
+				AppendPointerToken(m_szPath, szIndex, (size_t)iLength);
+
+				if (bBoth)
+					Walk(a[i], b[i]);
+				else
+					m_Callback(m_szPath, i < a.size() ? &a[i] : nullptr, i < b.size() ? &b[i] : nullptr);
+
+				m_szPath.resize(uPathLength);
+			}
+
+			return;
+		}
+
+		// members are ordered by label on both sides, walk them side by side
+		const Node::Children& mA = lhs.m_pChildren->m_Value;
+		const Node::Children& mB = rhs.m_pChildren->m_Value;
+
+		auto a = mA.begin();
+		auto b = mB.begin();
+
+		while (a != mA.end() || b != mB.end())
+		{
+			int iOrder = a == mA.end() ? 1 : b == mB.end() ? -1 : a->first.compare(b->first);
+
+			if (iOrder == 0 && Same(a->second, b->second))
+			{
+				++a;
+				++b;
+				continue;
+			}
+
+			const utf8nodestring& szLabel = iOrder <= 0 ? a->first : b->first;
+			AppendPointerToken(m_szPath, szLabel.data(), szLabel.size());
+
+			if (iOrder == 0)
+				Walk((a++)->second, (b++)->second);
+			else if (iOrder < 0)
+				m_Callback(m_szPath, &(a++)->second, nullptr);
+			else
+				m_Callback(m_szPath, nullptr, &(b++)->second);
+
+			m_szPath.resize(uPathLength);
+		}
+	}
+};
+
+size_t Diff(const Node& lhs, const Node& rhs, const DiffCallback& callback, bool bExact)
+{
+	NodeDiff diff{ callback, bExact, 0, utf8string() };
+
+	if (!diff.Same(lhs, rhs))
+		diff.Walk(lhs, rhs);
+
+	return diff.m_uVisited;
 }
 
 void Node::Reset()
@@ -336,25 +1076,43 @@ void Node::Reset()
 		case Type::Number:
 			break;
 		case Type::String:
-			m_szValue.clear();
-			m_szValue.~decltype(m_szValue)();
+			NodeStorage::Release(m_pString);
 			break;
 		case Type::Array:
-			m_vElements.clear();
-			m_vElements.~decltype(m_vElements)();
+			NodeStorage::Release(m_pElements);
 			break;
 		case Type::Object:
-			m_mChildren.clear();
-			m_mChildren.~decltype(m_mChildren)();
+			NodeStorage::Release(m_pChildren);
 			break;
 		default:
 			break;
 	}
 
-	memset(this, 0, sizeof(Node));
+	memset((void*)this, 0, sizeof(Node));
 	m_eType = Type::Null;
 }
 
+void Node::Init(Type eType, MemoryResource* pResource)
+{
+	Reset();
+	m_eType = eType;
+
+	switch (eType)
+	{
+		case Type::String:
+			m_pString = NodeStorage::Create<utf8nodestring>(pResource, Allocator<utf8_t>(pResource));
+			break;
+		case Type::Array:
+			m_pElements = NodeStorage::Create<Elements>(pResource, Allocator<Node>(pResource));
+			break;
+		case Type::Object:
+			m_pChildren = NodeStorage::Create<Children>(pResource, Allocator<Children::value_type>(pResource));
+			break;
+		default:
+			break;
+	}
+}
+
 }
 
 #undef ON_TYPE_CHECK_FAIL
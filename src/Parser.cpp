@@ -1,10 +1,31 @@
 #include <n2ajl/Parser.h>
+#include <n2ajl/Projection.h>
+#include <n2ajl/Schema.h>
 #include <n2ajl/UTF.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 namespace n2ajl
 {
 
-thread_local char szError[256] = {};
+// where and why parsing stopped, turned into a Result once the parse unwinds
+struct ParseError
+{
+	ErrorCode m_eCode = ErrorCode::None;
+	const utf8_t* m_pAt = nullptr;
+	uint32_t m_uChar = 0;
+
+	bool Fail(ErrorCode eCode, const utf8_t* pAt, uint32_t uChar = 0)
+	{
+		m_eCode = eCode;
+		m_pAt = pAt;
+		m_uChar = uChar;
+		return false;
+	}
+};
 
 inline bool IsWhitespace(utf32_t ch)
 {
@@ -16,14 +37,11 @@ inline bool IsLiteralTerminator(uint32_t ch)
 	return ch == ',' || ch == ']' || ch == '}';
 }
 
-bool SkipWhitespace(UTF8Iterator& iter)
+bool SkipWhitespace(UTF8Iterator& iter, ParseError& err)
 {
 	uint32_t h = iter.Read();
 	if (!h)
-	{
-		snprintf(szError, sizeof(szError), "Unexpected end of stream");
-		return false;
-	}
+		return err.Fail(ErrorCode::UnexpectedEnd, iter.GetReadPtr());
 
 	// trim leading whitespace
 	while (h && IsWhitespace(h))
@@ -36,10 +54,10 @@ bool SkipWhitespace(UTF8Iterator& iter)
 }
 
 // TODO: handle Unicode escape sequences (\uXXXX)
-bool GetNextString(UTF8Iterator& iter, std::string& str)
+// on success pStart/uLength span the raw string contents between the quotes
+bool GetNextString(UTF8Iterator& iter, ParseError& err, const utf8_t*& pStart, size_t& uLength)
 {
-	str = "";
-	if (!SkipWhitespace(iter))
+	if (!SkipWhitespace(iter, err))
 		return false;
 
 	uint32_t ch = iter.Read();
@@ -50,7 +68,7 @@ bool GetNextString(UTF8Iterator& iter, std::string& str)
 
 	iter.Advance(); // skip first quotes
 
-	// we record the start ptr after advancing and advance after copying to omit the quotes
+	// we record the start ptr after advancing and advance after measuring to omit the quotes
 	auto* start = iter.GetReadPtr();
 
 	while (ch = iter.Read())
@@ -65,10 +83,8 @@ bool GetNextString(UTF8Iterator& iter, std::string& str)
 		{
 			if (!bEscape) // if not escaped, terminate the string
 			{
-				size_t len = iter.GetReadPtr() - start;
-				str.resize(len);
-
-				memcpy(const_cast<char*>(str.data()), start, len);
+				pStart = start;
+				uLength = iter.GetReadPtr() - start;
 
 				if (!iter.Advance())
 					return false;
@@ -84,16 +100,16 @@ bool GetNextString(UTF8Iterator& iter, std::string& str)
 	return false; // non-terminated string...
 }
 
-bool GetNextLiteral(UTF8Iterator& iter, std::string& str)
+// literals are not copied, pStart/uLength point into the input
+bool GetNextLiteral(UTF8Iterator& iter, ParseError& err, const utf8_t*& pStart, size_t& uLength)
 {
-	str = "";
-	if (!SkipWhitespace(iter))
+	if (!SkipWhitespace(iter, err))
 		return false;
 
 	uint32_t ch = iter.Read();
 
 	if (ch == '\"') // special case
-		return GetNextString(iter, str);
+		return GetNextString(iter, err, pStart, uLength);
 
 	auto* start = iter.GetReadPtr();
 
@@ -106,10 +122,8 @@ bool GetNextLiteral(UTF8Iterator& iter, std::string& str)
 		{
 			if (iter.GetReadPtr() != start)
 			{
-				size_t len = iter.GetReadPtr() - start;
-				str.resize(len);
-
-				memcpy(const_cast<char*>(str.data()), start, len);
+				pStart = start;
+				uLength = iter.GetReadPtr() - start;
 				return true;
 			}
 			else
@@ -124,53 +138,457 @@ bool GetNextLiteral(UTF8Iterator& iter, std::string& str)
 	return false; // non-terminated string...
 }
 
-// supports only 1 main scope which encapsulates an object or an array
-Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Node& n)
+// past the closing quote of the string whose contents start at p, null if it is not terminated
+const utf8_t* SkipString(const utf8_t* p, const utf8_t* pEnd)
 {
-	n = Node(); // reset to null
-	Node::Type eType = Node::Type::Null;
+	const utf8_t* pContents = p;
 
-	bool bLabel = false;
-	bool bTerminated = false;
-	size_t uScopeStart = iter.GetPosition();
-	size_t uLabelEnd = SIZE_MAX;
-	size_t uMemberStart = SIZE_MAX;
-	uint32_t ch = 0;
-	std::string szCurLabel;
+	while (const utf8_t* pQuote = (const utf8_t*)memchr(p, '\"', pEnd - p))
+	{
+		// an odd run of backslashes escapes the quote
+		size_t uBackslashes = 0;
+		while (pQuote - uBackslashes > pContents && pQuote[-1 - (ptrdiff_t)uBackslashes] == '\\')
+			uBackslashes++;
+
+		if (!(uBackslashes & 1))
+			return pQuote + 1;
+
+		p = pQuote + 1;
+	}
 
-	// helper functions (dumps error into szError)
+	return nullptr;
+}
+
+// moves past the value at the cursor without decoding it, for members left out by a projection.
+// only string termination and bracket balance (within uMaxDepth) are checked
+bool SkipValue(UTF8Iterator& iter, ParseError& err, size_t uCurDepth, size_t uMaxDepth)
+{
+	const utf8_t* pStart = iter.GetReadPtr();
+	const utf8_t* pEnd = pStart + iter.GetNumBytesLeft();
+	const utf8_t* p = pStart;
+	utf8_t chFirst = *p;
 
-	auto AddNode = [&szCurLabel](Node& parent, const Node& inner)
+	if (chFirst == '\"')
+	{
+		if (!(p = SkipString(p + 1, pEnd)))
+			return err.Fail(ErrorCode::UnexpectedCharacter, pEnd, chFirst);
+	}
+	else if (chFirst == '{' || chFirst == '[')
 	{
-		switch (parent.GetType())
+		size_t uOpen = 0;
+
+		do
 		{
-			case Node::Type::Object:
-				if (szCurLabel.empty())
-				{
-					snprintf(szError, sizeof(szError), "Internal error, missing label");
-					return false;
-				}
+			switch (*p)
+			{
+				case '\"':
+					if (!(p = SkipString(p + 1, pEnd)))
+						return err.Fail(ErrorCode::UnterminatedSpan, pStart, chFirst);
 
-				parent.Set(szCurLabel, inner);
-				szCurLabel.clear();
-				break;
-			case Node::Type::Array:
-				parent.Append(inner);
-				break;
-			default:
-				snprintf(szError, sizeof(szError), "Internal error, bad node type");
-				return false;
+					continue;
+				case '{':
+				case '[':
+					if (uCurDepth + ++uOpen >= uMaxDepth)
+						return err.Fail(ErrorCode::TooDeep, p);
+
+					break;
+				case '}':
+				case ']':
+					uOpen--;
+					break;
+				default:
+					break;
+			}
+
+			p++;
+		} while (uOpen && p < pEnd);
+
+		if (uOpen)
+			return err.Fail(ErrorCode::UnterminatedSpan, pStart, chFirst);
+	}
+	else
+	{
+		while (p < pEnd && !IsLiteralTerminator((uint8_t)*p) && !IsWhitespace((uint8_t)*p))
+			p++;
+
+		if (p == pStart || p == pEnd)
+			return err.Fail(ErrorCode::UnexpectedCharacter, p, chFirst);
+	}
+
+	iter.Seek(p);
+	return true;
+}
+
+// the parser writes straight into Node storage, which lets a reparse keep existing strings, members and elements
+struct NodeBuilder
+{
+	// turns n into an empty container, or keeps an unshared container of the same type when reusing;
+	// returns true if new storage was allocated
+	static bool BeginSpan(Node& n, Node::Type eType, MemoryResource* pResource, bool bReuse)
+	{
+		if (bReuse && n.m_eType == eType && !n.IsShared())
+		{
+			// only drops the cached hash, the storage is ours alone
+			if (eType == Node::Type::Object)
+				n.MutableChildren();
+			else
+				n.MutableElements();
+
+			return false;
 		}
 
+		n.Init(eType, pResource);
 		return true;
-	};
+	}
+
+	static void SetScalar(Node& n, Node::Type eType, bool bValue, double dblValue)
+	{
+		if (n.m_eType == Node::Type::String || n.m_eType == Node::Type::Array || n.m_eType == Node::Type::Object)
+			n.Reset();
+
+		n.m_eType = eType;
+
+		if (eType == Node::Type::Boolean)
+			n.m_bValue = bValue;
+		else if (eType == Node::Type::Number)
+			n.m_dblValue = dblValue;
+	}
+
+	// returns the number of allocations made, the capacity of an unshared string is reused
+	static size_t SetString(Node& n, const utf8_t* pValue, size_t uLength, MemoryResource* pResource)
+	{
+		size_t uAllocations = 0;
+
+		// a string shared with another tree is replaced rather than cloned just to be overwritten
+		if (n.m_eType != Node::Type::String || n.IsShared())
+		{
+			n.Init(Node::Type::String, pResource);
+			uAllocations++;
+		}
+
+		utf8nodestring& szValue = n.MutableString();
+		size_t uCapacity = szValue.capacity();
+		szValue.assign(pValue, uLength);
+
+		if (szValue.capacity() != uCapacity)
+			uAllocations++;
+
+		return uAllocations;
+	}
+
+	// the span accessors below rely on BeginSpan having left n with storage of its own
+
+	// finds the member for szLabel or inserts a null one, the key is allocated alongside the map
+	static Node::Children::value_type& GetMember(Node& n, const utf8nodestring& szLabel, bool& bInserted)
+	{
+		Node::Children& children = n.m_pChildren->m_Value;
+
+		auto it = children.lower_bound(szLabel);
+		bInserted = it == children.end() || szLabel < it->first;
+
+		if (bInserted)
+		{
+			it = children.emplace_hint(it, std::piecewise_construct,
+									   std::forward_as_tuple(szLabel.data(), szLabel.size(), children.get_allocator()),
+									   std::forward_as_tuple());
+		}
+
+		return *it;
+	}
+
+	// marks a member as seen by the reparse, after its value was written (Reset clears the marker)
+	static void TouchMember(Node& member)
+	{
+		member.m_bTouched = true;
+	}
+
+	// drops members the reparse did not see and clears the markers
+	static void EndObject(Node& n)
+	{
+		Node::Children& children = n.m_pChildren->m_Value;
+
+		for (auto it = children.begin(); it != children.end();)
+		{
+			if (!it->second.m_bTouched)
+			{
+				it = children.erase(it);
+				continue;
+			}
+
+			it->second.m_bTouched = false;
+			++it;
+		}
+	}
+
+	static Node& GetElement(Node& n, size_t i)
+	{
+		Node::Elements& elements = n.m_pElements->m_Value;
+
+		if (i < elements.size())
+			return elements[i];
+
+		elements.emplace_back();
+		return elements.back();
+	}
+
+	// const access, Node::At is the write path and drops the cached hash
+	static Node::Type FirstElementType(const Node& n)
+	{
+		return n.m_pElements->m_Value[0].m_eType;
+	}
+
+	static size_t Capacity(const Node& n)
+	{
+		return n.m_pElements->m_Value.capacity();
+	}
+
+	// drops elements past the reparsed count and records the (uniform) element type
+	static void EndArray(Node& n, size_t uCount)
+	{
+		Node::Elements& elements = n.m_pElements->m_Value;
+
+		if (uCount < elements.size())
+			elements.erase(elements.begin() + uCount, elements.end());
+
+		n.m_eElementType = uCount ? elements[0].m_eType : Node::Type::Null;
+	}
+
+	// what a budget charges for each part of the tree, the amounts Node::GetMemoryUsage adds up
+	static size_t StringBytes(const Node& n)
+	{
+		return Node::BlockBytes(Node::Type::String) + Node::HeapBytes(n.m_pString->m_Value);
+	}
+
+	static size_t SpanBytes(const Node& n)
+	{
+		return Node::BlockBytes(n.m_eType) + (n.m_eType == Node::Type::Array ? Capacity(n) * sizeof(Node) : 0);
+	}
+
+	static size_t MemberBytes(const utf8nodestring& szLabel)
+	{
+		return Node::MemberBytes() + Node::HeapBytes(szLabel);
+	}
+};
+
+// statistics are gathered through a policy so the disabled path compiles down to nothing
+template<bool bEnabled>
+class ParseRecorder
+{
+public:
+	explicit ParseRecorder(ParserStats*) {}
+
+	void OnDepth(size_t) {}
+	void OnNode(Node::Type) {}
+	void OnSpan(bool) {}
+	void OnString(size_t, size_t) {}
+	void OnMember(size_t, bool) {}
+	void OnElement(size_t, size_t) {}
+	void OnSkip(size_t) {}
+	void EndScan() {}
+	void EndBuild(size_t) {}
+};
+
+template<>
+class ParseRecorder<true>
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit ParseRecorder(ParserStats* pStats) : m_Stats(*pStats), m_Start(Clock::now())
+	{
+		m_Stats = ParserStats();
+	}
+
+	void OnDepth(size_t uDepth)
+	{
+		if (uDepth > m_Stats.m_uMaxDepth)
+			m_Stats.m_uMaxDepth = uDepth;
+	}
+
+	void OnNode(Node::Type eType)
+	{
+		m_Stats.m_uNodes[(size_t)eType]++;
+	}
+
+	void OnSpan(bool bAllocated)
+	{
+		if (bAllocated)
+			m_Stats.m_uAllocations++;
+	}
+
+	void OnString(size_t uLength, size_t uAllocations)
+	{
+		m_Stats.m_uStringBytes += uLength;
+		m_Stats.m_uAllocations += uAllocations;
+	}
+
+	// only inserted members copy their label, a reused or duplicate one is just compared
+	void OnMember(size_t uLabelLength, bool bInserted)
+	{
+		if (!bInserted)
+			return;
+
+		// label keys only allocate once they outgrow the small string buffer
+		OnString(uLabelLength, uLabelLength > s_uSmallString ? 1 : 0);
+		m_Stats.m_uAllocations++; // member node
+	}
+
+	void OnElement(size_t uOldCapacity, size_t uNewCapacity)
+	{
+		if (uOldCapacity != uNewCapacity)
+			m_Stats.m_uAllocations++;
+	}
+
+	void OnSkip(size_t uBytes)
+	{
+		m_Stats.m_uSkippedBytes += uBytes;
+	}
+
+	void EndScan()
+	{
+		Clock::time_point now = Clock::now();
+		m_Stats.m_uScanNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_Start).count();
+		m_Start = now;
+	}
+
+	void EndBuild(size_t uBytes)
+	{
+		m_Stats.m_uBuildNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_Start).count();
+		m_Stats.m_uBytes = uBytes;
+	}
+
+private:
+	static const size_t s_uSmallString;
+
+	ParserStats& m_Stats;
+	Clock::time_point m_Start;
+};
+
+const size_t ParseRecorder<true>::s_uSmallString = utf8string().capacity();
+
+// the limits of ParserConfig, a parse without any compiles the checks away like disabled statistics
+template<bool bEnabled>
+class ParseBudget
+{
+public:
+	explicit ParseBudget(const ParserConfig&) {}
+
+	ErrorCode OnValue() { return ErrorCode::None; }
+	ErrorCode OnString(size_t) { return ErrorCode::None; }
+	ErrorCode ChargeString(const Node&) { return ErrorCode::None; }
+	ErrorCode ChargeSpan(const Node&) { return ErrorCode::None; }
+	ErrorCode ChargeMember(const utf8nodestring&) { return ErrorCode::None; }
+	ErrorCode ChargeElements(size_t, size_t) { return ErrorCode::None; }
+};
+
+template<>
+class ParseBudget<true>
+{
+public:
+	explicit ParseBudget(const ParserConfig& cfg) :
+		m_uBytesLeft(cfg.m_uMaxBytes ? cfg.m_uMaxBytes : SIZE_MAX),
+		m_uNodesLeft(cfg.m_uMaxNodes ? cfg.m_uMaxNodes : SIZE_MAX),
+		m_uMaxString(cfg.m_uMaxStringLength ? cfg.m_uMaxStringLength : SIZE_MAX)
+	{
+	}
+
+	ErrorCode OnValue()
+	{
+		if (!m_uNodesLeft)
+			return ErrorCode::TooManyNodes;
+
+		m_uNodesLeft--;
+		return ErrorCode::None;
+	}
+
+	// before a string or label is copied, its buffer will take at least its length
+	ErrorCode OnString(size_t uLength)
+	{
+		if (uLength > m_uMaxString)
+			return ErrorCode::StringTooLong;
+
+		return uLength > m_uBytesLeft ? ErrorCode::TooLarge : ErrorCode::None;
+	}
+
+	ErrorCode ChargeString(const Node& n) { return Charge(NodeBuilder::StringBytes(n)); }
+	ErrorCode ChargeSpan(const Node& n) { return Charge(NodeBuilder::SpanBytes(n)); }
+	ErrorCode ChargeMember(const utf8nodestring& szLabel) { return Charge(NodeBuilder::MemberBytes(szLabel)); }
+
+	ErrorCode ChargeElements(size_t uOldCapacity, size_t uNewCapacity)
+	{
+		return Charge((uNewCapacity - uOldCapacity) * sizeof(Node));
+	}
+
+private:
+	ErrorCode Charge(size_t uBytes)
+	{
+		if (uBytes > m_uBytesLeft)
+			return ErrorCode::TooLarge;
+
+		m_uBytesLeft -= uBytes;
+		return ErrorCode::None;
+	}
+
+	size_t m_uBytesLeft;
+	size_t m_uNodesLeft;
+	size_t m_uMaxString;
+};
+
+template<typename Recorder, typename Budget>
+struct ParseContext
+{
+	UTF8Iterator& m_Iter;
+	Recorder& m_Rec;
+	Budget& m_Budget;
+	ParseError& m_Error;
+	size_t m_uMaxDepth;
+	MemoryResource* m_pResource;
+	bool m_bReuse;
+	bool m_bHash;
+	const Projection* m_pProjection;
+	const Schema* m_pSchema;
+};
+
+// labels are only needed to find the member, one scratch string per thread keeps reparsing allocation free.
+// it allocates from new/delete, a default resource set later could be gone before the thread ends
+thread_local utf8nodestring szLabelScratch{ Allocator<utf8_t>(GetNewDeleteResource()) };
+
+// supports only 1 main scope which encapsulates an object or an array
+// builds directly into n, reusing its contents when ctx.m_bReuse is set
+// returns false with ctx.m_Error describing the failure; pProjection is null when everything is kept,
+// pSchema when anything is accepted
+template<typename Recorder, typename Budget>
+bool GenerateNodes(ParseContext<Recorder, Budget>& ctx, size_t uCurDepth, Node& n, const Projection::Entry* pProjection,
+				   const Schema::Entry* pSchema)
+{
+	UTF8Iterator& iter = ctx.m_Iter;
+	Recorder& rec = ctx.m_Rec;
+	Budget& budget = ctx.m_Budget;
+	ParseError& err = ctx.m_Error;
+	Node::Type eType = Node::Type::Null;
+
+	bool bLabel = false;
+	bool bTerminated = false;
+	const utf8_t* pScopeStart = iter.GetReadPtr();
+	const utf8_t* pLabelEnd = nullptr;
+	bool bColon = false;
+	size_t uElements = 0; // elements written so far
+	uint32_t ch = 0;
+	Node* pTarget = nullptr; // member or element the next value is written into, null to skip it
+	const Projection::Entry* pTargetProjection = pProjection; // elements are projected like their array
+	const Schema::Entry* pTargetSchema = nullptr;
+	uint64_t uRequiredSeen = 0;
+
+	rec.OnDepth(uCurDepth + 1);
+
+	// helper functions (record failures in err)
 
 	auto StringAdvance = [&]()
 	{
 		if (!iter.Advance())
 			return false;
 
-		if (!SkipWhitespace(iter))
+		if (!SkipWhitespace(iter, err))
 			return false;
 
 		ch = iter.Read();
@@ -180,47 +598,50 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 	auto BuildSpanInner = [&]()
 	{
 		size_t uNextDepth = uCurDepth + 1;
-		if (uNextDepth >= uMaxDepth)
-		{
-			snprintf(szError, sizeof(szError), "Too many nested spans at position %d", iter.GetPosition());
-			return false;
-		}
-
-		Node inner;
-		Result res = GenerateNodes(iter, uNextDepth, uMaxDepth, inner);
+		if (uNextDepth >= ctx.m_uMaxDepth)
+			return err.Fail(ErrorCode::TooDeep, iter.GetReadPtr());
 
-		if (!res.m_bSuccess) // failed
-			return false;
-
-		return AddNode(n, inner);
+		return GenerateNodes(ctx, uNextDepth, *pTarget, pTargetProjection, pTargetSchema);
 	};
 
 	auto BuildSpanLiteral = [&]()
 	{
-		size_t uStartPos = iter.GetPosition();
+		const utf8_t* pStart = iter.GetReadPtr();
 
-		std::string str;
-		if (!GetNextLiteral(iter, str))
-		{
-			snprintf(szError, sizeof(szError), "Malformed object, unexpected \'%c\' at position %d",
-					 (char)ch, iter.GetPosition());
-			return false;
-		}
+		const utf8_t* z = nullptr;
+		size_t uLength = 0;
+
+		if (!GetNextLiteral(iter, err, z, uLength))
+			return err.Fail(ErrorCode::UnexpectedCharacter, iter.GetReadPtr(), ch);
+
+		ErrorCode eOver = budget.OnValue();
+		if (eOver != ErrorCode::None)
+			return err.Fail(eOver, pStart);
 
 		switch (ch)
 		{
 			case '"':
 			{
-				return AddNode(n, Node(str));
+				eOver = budget.OnString(uLength);
+				if (eOver != ErrorCode::None)
+					return err.Fail(eOver, pStart);
+
+				rec.OnNode(Node::Type::String);
+				rec.OnString(uLength, NodeBuilder::SetString(*pTarget, z, uLength, ctx.m_pResource));
+
+				eOver = budget.ChargeString(*pTarget);
+				if (eOver != ErrorCode::None)
+					return err.Fail(eOver, pStart);
+
+				return true;
 			}
 			case 't':
 			case 'f':
 			case 'n':
 			{
-				const utf8_t* z = str.c_str();
 				uint64_t token = 0;
 
-				switch (str.length())
+				switch (uLength)
 				{
 					case 5: // fallthrough
 						token |= ((uint64_t)z[4] << 32);
@@ -228,40 +649,44 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 						token |= (uint64_t)z[0] | ((uint64_t)z[1] << 8) | ((uint64_t)z[2] << 16) | ((uint64_t)z[3] << 24);
 						break;
 					default:
-						snprintf(szError, sizeof(szError), "Malformed object, unexpected \'%c\' at position %d", (char)ch, uStartPos);
-						return false;
+						return err.Fail(ErrorCode::UnexpectedCharacter, pStart, ch);
 				}
 
 				if (token == 0x65757274) // true
 				{
-					return AddNode(n, Node(true));
+					rec.OnNode(Node::Type::Boolean);
+					NodeBuilder::SetScalar(*pTarget, Node::Type::Boolean, true, 0.0);
+					return true;
 				}
 				else if (token == 0x65736c6166) // false
 				{
-					return AddNode(n, Node(false));
+					rec.OnNode(Node::Type::Boolean);
+					NodeBuilder::SetScalar(*pTarget, Node::Type::Boolean, false, 0.0);
+					return true;
 				}
 				else if (token == 0x6c6c756e) // null
 				{
-					return AddNode(n, Node());
+					rec.OnNode(Node::Type::Null);
+					NodeBuilder::SetScalar(*pTarget, Node::Type::Null, false, 0.0);
+					return true;
 				}
 				else
 				{
-					snprintf(szError, sizeof(szError), "Malformed object, unexpected \'%c\' at position %d", (char)ch, uStartPos);
-					return false;
+					return err.Fail(ErrorCode::UnexpectedCharacter, pStart, ch);
 				}
 			}
 			default:
 			{
+				// the literal is followed by a terminator or whitespace, neither of which strtod consumes
 				char* e;
-				double num = strtod(str.c_str(), &e);
+				double num = strtod(z, &e);
 
-				if (e != str.c_str() + str.length()) // did not reach end of string
-				{
-					snprintf(szError, sizeof(szError), "Failed to parse literal at position %d", uStartPos);
-					return false;
-				}
+				if (e != z + uLength) // did not reach end of literal
+					return err.Fail(ErrorCode::BadLiteral, pStart);
 
-				return AddNode(n, Node(num));
+				rec.OnNode(Node::Type::Number);
+				NodeBuilder::SetScalar(*pTarget, Node::Type::Number, false, num);
+				return true;
 			}
 		}
 	};
@@ -269,18 +694,33 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 	auto ParseMember = [&]()
 	{
 		// try to parse the member...
-		if (ch == '{' || ch == '[') // object or array span
+		if (!pTarget) // left out by the projection
+		{
+			const utf8_t* pStart = iter.GetReadPtr();
+
+			if (!SkipValue(iter, err, uCurDepth, ctx.m_uMaxDepth))
+				return false;
+
+			rec.OnSkip(iter.GetReadPtr() - pStart);
+		}
+		else if (ch == '{' || ch == '[') // object or array span
 		{
 			if (!BuildSpanInner())
 				return false;
 		}
 		else // try to parse as a literal
 		{
+			const utf8_t* pStart = iter.GetReadPtr();
+
 			if (!BuildSpanLiteral())
 				return false;
+
+			ErrorCode eViolation = ctx.m_pSchema ? ctx.m_pSchema->CheckValue(pTargetSchema, *pTarget) : ErrorCode::None;
+			if (eViolation != ErrorCode::None)
+				return err.Fail(eViolation, pStart);
 		}
 
-		if (!SkipWhitespace(iter))
+		if (!SkipWhitespace(iter, err))
 			return false;
 
 		// re-read current character
@@ -292,17 +732,12 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 	auto CheckMemberTerminationAndAdvance = [&]()
 	{
 		if (!IsLiteralTerminator(ch)) // we're expecting a terminator after a member
-		{
-			snprintf(szError, sizeof(szError), "Malformed object, unexpected \'%c\' at position %d",
-					 (char)ch,
-					 iter.GetPosition());
-			return false;
-		}
+			return err.Fail(ErrorCode::UnexpectedCharacter, iter.GetReadPtr(), ch);
 
 		// reset member state
 		bLabel = false;
-		uLabelEnd = SIZE_MAX;
-		uMemberStart = SIZE_MAX;
+		pLabelEnd = nullptr;
+		bColon = false;
 
 		if (ch == ',') // only skip comma, brackets are needed for span termination
 			StringAdvance();
@@ -310,17 +745,14 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 		return true;
 	};
 
-	if (!SkipWhitespace(iter)) { goto BuildSpanFail; } // reached end...
+	if (!SkipWhitespace(iter, err)) { return false; } // reached end...
 
 	while (ch = iter.Read())
 	{
 		// we only expect ASCII characters while parsing structures
 		// string literals are handled in BuildSpanLiteral and the pointer is advanced
 		if (ch >= 0x7F)
-		{
-			snprintf(szError, sizeof(szError), "Unexpected character at position %d", iter.GetPosition());
-			goto BuildSpanFail;
-		}
+			return err.Fail(ErrorCode::NonAscii, iter.GetReadPtr());
 
 		// check span scope
 		if (eType == Node::Type::Null) // start of span, check for opening characters
@@ -329,25 +761,40 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 			{
 				case '{':
 				{
-					n = Node::Object();
-					eType = n.GetType();
+					eType = Node::Type::Object;
 					break;
 				}
 				case '[':
 				{
-					n = Node::Array();
-					eType = n.GetType();
+					eType = Node::Type::Array;
 					break;
 				}
 				default:
-				{
-					snprintf(szError, sizeof(szError), "Malformed object, found \'%c\' at position %d, expected start character",
-							 (char)ch,
-							 iter.GetPosition());
-					goto BuildSpanFail;
-				}
+					return err.Fail(ErrorCode::ExpectedSpan, iter.GetReadPtr(), ch);
+			}
+
+			// the type is known before anything inside the span is built
+			if (pSchema)
+			{
+				ErrorCode eViolation = ctx.m_pSchema->CheckType(pSchema, eType);
+				if (eViolation != ErrorCode::None)
+					return err.Fail(eViolation, iter.GetReadPtr());
+
+				if (eType == Node::Type::Array)
+					pTargetSchema = ctx.m_pSchema->GetItems(pSchema);
 			}
 
+			ErrorCode eOver = budget.OnValue();
+			if (eOver != ErrorCode::None)
+				return err.Fail(eOver, iter.GetReadPtr());
+
+			rec.OnSpan(NodeBuilder::BeginSpan(n, eType, ctx.m_pResource, ctx.m_bReuse));
+			rec.OnNode(eType);
+
+			eOver = budget.ChargeSpan(n);
+			if (eOver != ErrorCode::None)
+				return err.Fail(eOver, iter.GetReadPtr());
+
 			goto AdvanceChar;
 		}
 		else if ((ch == '}' && eType == Node::Type::Object) ||
@@ -368,62 +815,88 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 				if (ch == '\"') // if the next character is a string...
 				{
 					bLabel = true; // we found a label
-					size_t uStartPos = iter.GetPosition();
+					const utf8_t* pStart = iter.GetReadPtr();
+
+					const utf8_t* pLabel = nullptr;
+					size_t uLabelLength = 0;
 
-					std::string str; // get the label string
-					if (!GetNextLiteral(iter, str))
+					if (!GetNextLiteral(iter, err, pLabel, uLabelLength)) // get the label string
 					{
-						snprintf(szError, sizeof(szError), "Malformed object, unexpected \'%c\' at position %d",
-								 (char)ch,
-								 uStartPos);
-						goto BuildSpanFail;
+						return err.Fail(ErrorCode::UnexpectedCharacter, pStart, ch);
 					}
 					else // ...record the label span and skip forward
 					{
-						if (str.empty())
+						if (!uLabelLength)
+							return err.Fail(ErrorCode::EmptyLabel, pStart);
+
+						ErrorCode eOver = budget.OnString(uLabelLength);
+						if (eOver != ErrorCode::None)
+							return err.Fail(eOver, pStart);
+
+						// a required member counts as present even when the projection leaves it out
+						if (pSchema)
 						{
-							snprintf(szError, sizeof(szError), "Empty identifier at position %d", uStartPos);
-							goto BuildSpanFail;
+							uint64_t uRequired = 0;
+							pTargetSchema = ctx.m_pSchema->FindProperty(pSchema, pLabel, uLabelLength, uRequired);
+							uRequiredSeen |= uRequired;
 						}
 
-						szCurLabel = str;
-						uLabelEnd = iter.GetPosition();
+						if (!pProjection || ctx.m_pProjection->Find(pProjection, pLabel, uLabelLength, pTargetProjection))
+						{
+							bool bInserted = false;
+							szLabelScratch.assign(pLabel, uLabelLength);
 
-						if (!SkipWhitespace(iter))
-							goto BuildSpanFail;
+							auto& member = NodeBuilder::GetMember(n, szLabelScratch, bInserted);
+							pTarget = &member.second;
+							rec.OnMember(uLabelLength, bInserted);
+
+							eOver = budget.ChargeMember(member.first);
+							if (eOver != ErrorCode::None)
+								return err.Fail(eOver, pStart);
+						}
+						else
+						{
+							pTarget = nullptr;
+						}
+
+						pLabelEnd = iter.GetReadPtr();
+
+						if (!SkipWhitespace(iter, err))
+							return false;
 
 						continue;
 					}
 				}
 				else
 				{
-					snprintf(szError, sizeof(szError), "Malformed object, expected '\"\' at position %d", iter.GetPosition());
-					goto BuildSpanFail;
+					return err.Fail(ErrorCode::ExpectedLabel, iter.GetReadPtr());
 				}
 			}
 			else // we have a label, now we're looking for a member
 			{
-				if (uMemberStart == SIZE_MAX) // we do not have a member, look for a delimiter
+				if (!bColon) // we do not have a member, look for a delimiter
 				{
 					if (ch == ':') // a member delimiter, next character marks the beginning of the member
 					{
-						uMemberStart = iter.GetPosition();
+						bColon = true;
 						goto AdvanceChar;
 					}
 					else // did not find what we were looking for...
 					{
-						snprintf(szError, sizeof(szError), "Malformed object, expected \':\' at position %d", iter.GetPosition());
-						goto BuildSpanFail;
+						return err.Fail(ErrorCode::ExpectedColon, iter.GetReadPtr());
 					}
 				}
 				else // next character is the member (object, array, literal, etc)
 				{
 					if (!ParseMember())
-						goto BuildSpanFail; // szError contains failure message
+						return false; // err describes the failure
+
+					if (ctx.m_bReuse && pTarget)
+						NodeBuilder::TouchMember(*pTarget);
 
 					// check to see if the member was properly terminated
 					if (!CheckMemberTerminationAndAdvance())
-						goto BuildSpanFail;
+						return false;
 
 					// do NOT advance one character, terminators need to be read by code above to complete span
 					continue;
@@ -432,28 +905,32 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 		}
 		else if (eType == Node::Type::Array)
 		{
+			size_t uCapacity = NodeBuilder::Capacity(n);
+			pTarget = &NodeBuilder::GetElement(n, uElements++);
+			rec.OnElement(uCapacity, NodeBuilder::Capacity(n));
+
+			ErrorCode eOver = budget.ChargeElements(uCapacity, NodeBuilder::Capacity(n));
+			if (eOver != ErrorCode::None)
+				return err.Fail(eOver, iter.GetReadPtr());
+
 			if (!ParseMember())
-				goto BuildSpanFail; // szError contains failure message
+				return false; // err describes the failure
 
 			// all the array values need to be of the same type
 			// array should never be empty (ParseMember)
-			if (n.At(0)->GetType() != n.At(n.Length() - 1)->GetType())
-			{
-				snprintf(szError, sizeof(szError), "Malformed array, incorrect type at position %d", iter.GetPosition());
-				goto BuildSpanFail;
-			}
+			if (NodeBuilder::FirstElementType(n) != pTarget->GetType())
+				return err.Fail(ErrorCode::MixedArray, iter.GetReadPtr());
 
 			// check to see if the member was properly terminated
 			if (!CheckMemberTerminationAndAdvance())
-				goto BuildSpanFail;
+				return false;
 
 			// do NOT advance one character, terminators need to be read by code above to complete span
 			continue;
 		}
 		else
 		{
-			snprintf(szError, sizeof(szError), "Bad span type");
-			goto BuildSpanFail;
+			return err.Fail(ErrorCode::BadSpanType, iter.GetReadPtr());
 		}
 
 	AdvanceChar:
@@ -461,52 +938,217 @@ Result GenerateNodes(UTF8Iterator& iter, size_t uCurDepth, size_t uMaxDepth, Nod
 	}
 
 	// check for a dangling label without a matching value
-	if (eType == Node::Type::Object && uLabelEnd != SIZE_MAX)
-	{
-		snprintf(szError, sizeof(szError), "Expected an object member at position %d", uLabelEnd);
-		goto BuildSpanFail;
-	}
+	if (eType == Node::Type::Object && pLabelEnd)
+		return err.Fail(ErrorCode::ExpectedMember, pLabelEnd);
 
 	// if the span was never terminated, it is malformed
 	if (eType != Node::Type::Null && !bTerminated)
+		return err.Fail(ErrorCode::UnterminatedSpan, pScopeStart, eType == Node::Type::Object ? '{' : '[');
+
+	// no span opened, the input was only whitespace: the result is a null root whatever n held before
+	if (eType == Node::Type::Null)
+		n = Node();
+
+	// trim whatever the previous contents had beyond what was just parsed
+	if (eType == Node::Type::Object)
+	{
+		if (ctx.m_bReuse)
+			NodeBuilder::EndObject(n);
+	}
+	else if (eType == Node::Type::Array)
 	{
-		char chStart = ' ', chEnd = ' ';
+		NodeBuilder::EndArray(n, uElements);
+	}
 
-		if (eType == Node::Type::Object)
+	if (pSchema && eType != Node::Type::Null)
+	{
+		if (eType == Node::Type::Object && uRequiredSeen != pSchema->m_uRequired)
+			return err.Fail(ErrorCode::SchemaRequired, pScopeStart);
+
+		ErrorCode eViolation = ctx.m_pSchema->CheckValue(pSchema, n);
+		if (eViolation != ErrorCode::None)
+			return err.Fail(eViolation, pScopeStart);
+	}
+
+	// children closed first, so this only combines their cached hashes
+	if (ctx.m_bHash)
+		n.Hash();
+
+	return true;
+}
+
+template<bool bStats, bool bBudget>
+Result ParseRecorded(const ParserConfig& cfg, const utf8_t* szJson, Node& json, MemoryResource* pResource)
+{
+	ParseRecorder<bStats> rec(cfg.m_pStats);
+	ParseBudget<bBudget> budget(cfg);
+
+	UTF8Iterator iter(szJson);
+	rec.EndScan();
+
+	// reused trees keep allocating from the resource they were built with
+	if (cfg.m_bReuseNodes && !pResource)
+		pResource = json.GetResource();
+
+	ParseError err;
+	ParseContext<ParseRecorder<bStats>, ParseBudget<bBudget>> ctx{ iter, rec, budget, err, cfg.m_uMaxDepth, pResource, cfg.m_bReuseNodes, cfg.m_bComputeHashes, cfg.m_pProjection, cfg.m_pSchema };
+
+	bool bSuccess = GenerateNodes(ctx, 0, json, cfg.m_pProjection ? cfg.m_pProjection->GetRoot() : nullptr,
+								  cfg.m_pSchema ? cfg.m_pSchema->GetRoot() : nullptr);
+	rec.EndBuild(iter.GetReadPtr() - szJson);
+
+	Result res;
+	res.m_pSource = szJson;
+
+	if (!bSuccess)
+	{
+		json = Node(); // never leave a partially built tree behind
+
+		res.m_bSuccess = false;
+		res.m_eError = err.m_eCode;
+		res.m_uOffset = (uint64_t)(err.m_pAt - szJson);
+		res.m_uChar = err.m_uChar;
+	}
+
+	return res;
+}
+
+// walks the input from the start, errors are rare enough that nothing is precomputed for them
+template<typename Visitor>
+void WalkToOffset(const utf8_t* pSource, uint64_t uOffset, Visitor&& visitor)
+{
+	// bounded by the offset, Validate's input need not be NUL terminated
+	UTF8Iterator iter(pSource, (size_t)uOffset);
+	const utf8_t* pTarget = pSource + uOffset;
+
+	// a malformed codepoint cannot be advanced over, positions past it are reported at it
+	while (iter.GetReadPtr() < pTarget)
+	{
+		utf32_t ch = iter.Read();
+
+		if (!iter.Advance())
+			break;
+
+		visitor(ch);
+	}
+}
+
+void Result::GetLineColumn(uint64_t& uLine, uint64_t& uColumn) const
+{
+	uLine = 1;
+	uColumn = 1;
+
+	if (!m_pSource)
+		return;
+
+	WalkToOffset(m_pSource, m_uOffset, [&](utf32_t ch)
+	{
+		if (ch == '\n')
 		{
-			chStart = '{';
-			chEnd = '}';
+			uLine++;
+			uColumn = 1;
 		}
-		else if (eType == Node::Type::Array)
+		else
 		{
-			chStart = '[';
-			chEnd = ']';
+			uColumn++;
 		}
+	});
+}
 
-		snprintf(szError, sizeof(szError), R"(Expected a terminating '%c' for '%c' at position %d)",
-				 chStart,
-				 chEnd,
-				 uScopeStart);
+std::string Result::GetMessage() const
+{
+	// positions are codepoints from the start of the document, as they always were reported
+	unsigned long long uPosition = 0;
 
-		goto BuildSpanFail;
-	}
+	if (m_pSource)
+		WalkToOffset(m_pSource, m_uOffset, [&](utf32_t) { uPosition++; });
+	else
+		uPosition = m_uOffset; // a streamed input, only bytes are known
 
-	return { true, "" };
+	char chEnd = m_uChar == '{' ? '}' : ']';
+	char szMsg[128];
 
-BuildSpanFail:
-	n = Node();
-	return { false, szError };
+	switch (m_eError)
+	{
+		case ErrorCode::None:
+			return std::string();
+		case ErrorCode::UnexpectedEnd:
+			return "Unexpected end of stream";
+		case ErrorCode::TooDeep:
+			snprintf(szMsg, sizeof(szMsg), "Too many nested spans at position %llu", uPosition);
+			break;
+		case ErrorCode::UnexpectedCharacter:
+			snprintf(szMsg, sizeof(szMsg), "Malformed object, unexpected \'%c\' at position %llu", (char)m_uChar, uPosition);
+			break;
+		case ErrorCode::NonAscii:
+			snprintf(szMsg, sizeof(szMsg), "Unexpected character at position %llu", uPosition);
+			break;
+		case ErrorCode::ExpectedSpan:
+			snprintf(szMsg, sizeof(szMsg), "Malformed object, found \'%c\' at position %llu, expected start character", (char)m_uChar, uPosition);
+			break;
+		case ErrorCode::BadLiteral:
+			snprintf(szMsg, sizeof(szMsg), "Failed to parse literal at position %llu", uPosition);
+			break;
+		case ErrorCode::EmptyLabel:
+			snprintf(szMsg, sizeof(szMsg), "Empty identifier at position %llu", uPosition);
+			break;
+		case ErrorCode::ExpectedLabel:
+			snprintf(szMsg, sizeof(szMsg), "Malformed object, expected '\"\' at position %llu", uPosition);
+			break;
+		case ErrorCode::ExpectedColon:
+			snprintf(szMsg, sizeof(szMsg), "Malformed object, expected \':\' at position %llu", uPosition);
+			break;
+		case ErrorCode::MixedArray:
+			snprintf(szMsg, sizeof(szMsg), "Malformed array, incorrect type at position %llu", uPosition);
+			break;
+		case ErrorCode::ExpectedMember:
+			snprintf(szMsg, sizeof(szMsg), "Expected an object member at position %llu", uPosition);
+			break;
+		case ErrorCode::UnterminatedSpan:
+			snprintf(szMsg, sizeof(szMsg), R"(Expected a terminating '%c' for '%c' at position %llu)", (char)m_uChar, chEnd, uPosition);
+			break;
+		case ErrorCode::SchemaType:
+			snprintf(szMsg, sizeof(szMsg), "Schema violation, unexpected type at position %llu", uPosition);
+			break;
+		case ErrorCode::SchemaEnum:
+			snprintf(szMsg, sizeof(szMsg), "Schema violation, value not in enum at position %llu", uPosition);
+			break;
+		case ErrorCode::SchemaRange:
+			snprintf(szMsg, sizeof(szMsg), "Schema violation, number out of range at position %llu", uPosition);
+			break;
+		case ErrorCode::SchemaRequired:
+			snprintf(szMsg, sizeof(szMsg), "Schema violation, required member missing from object at position %llu", uPosition);
+			break;
+		case ErrorCode::ReadFailed:
+			return "Failed to read input";
+		case ErrorCode::BadEncoding:
+			snprintf(szMsg, sizeof(szMsg), "Malformed or unsupported item at position %llu", uPosition);
+			break;
+		case ErrorCode::TooLarge:
+			snprintf(szMsg, sizeof(szMsg), "Memory budget exceeded at position %llu", uPosition);
+			break;
+		case ErrorCode::TooManyNodes:
+			snprintf(szMsg, sizeof(szMsg), "Too many values at position %llu", uPosition);
+			break;
+		case ErrorCode::StringTooLong:
+			snprintf(szMsg, sizeof(szMsg), "String too long at position %llu", uPosition);
+			break;
+		case ErrorCode::BadSpanType:
+		default:
+			return "Bad span type";
+	}
+
+	return szMsg;
 }
 
-Result Parse(const ParserConfig& cfg, const utf8_t* szJson, Node& json)
+Result Parse(const ParserConfig& cfg, const utf8_t* szJson, Node& json, MemoryResource* pResource)
 {
-	UTF8Iterator iter(szJson);
-	Result status = GenerateNodes(iter, 0, cfg.m_uMaxDepth, json);
+	bool bBudget = cfg.m_uMaxBytes || cfg.m_uMaxNodes || cfg.m_uMaxStringLength;
 
-	if (!status.m_bSuccess)
-		return status;
+	if (cfg.m_pStats)
+		return bBudget ? ParseRecorded<true, true>(cfg, szJson, json, pResource) : ParseRecorded<true, false>(cfg, szJson, json, pResource);
 
-	return { true, "" };
+	return bBudget ? ParseRecorded<false, true>(cfg, szJson, json, pResource) : ParseRecorded<false, false>(cfg, szJson, json, pResource);
 }
 
 }
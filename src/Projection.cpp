@@ -0,0 +1,106 @@
+#include <n2ajl/Projection.h>
+#include <algorithm>
+
+namespace n2ajl
+{
+
+Projection::Projection()
+{
+	m_vEntries.emplace_back(); // root, keeps nothing until a path is added
+}
+
+bool Projection::SplitPath(const char* szPath, std::vector<std::string>& vTokens)
+{
+	vTokens.clear();
+
+	if (!*szPath)
+		return true;
+
+	if (*szPath != '/')
+		return false;
+
+	for (const char* p = szPath; *p;)
+	{
+		std::string szToken;
+
+		for (p++; *p && *p != '/'; p++)
+		{
+			if (*p != '~')
+			{
+				szToken += *p;
+				continue;
+			}
+
+			p++;
+
+			if (*p == '0')
+				szToken += '~';
+			else if (*p == '1')
+				szToken += '/';
+			else
+				return false;
+		}
+
+		vTokens.push_back(std::move(szToken));
+	}
+
+	return true;
+}
+
+bool Projection::Add(const char* szPath)
+{
+	// decode every token before touching the trie, a malformed path adds nothing
+	std::vector<std::string> vTokens;
+
+	if (!SplitPath(szPath, vTokens))
+		return false;
+
+	uint32_t uEntry = 0;
+
+	for (const std::string& szToken : vTokens)
+	{
+		if (m_vEntries[uEntry].m_bAll)
+			return true; // already kept by a shorter path
+
+		auto& vChildren = m_vEntries[uEntry].m_vChildren;
+		auto it = std::lower_bound(vChildren.begin(), vChildren.end(), szToken,
+								   [](const std::pair<std::string, uint32_t>& child, const std::string& szLabel) { return child.first < szLabel; });
+
+		if (it != vChildren.end() && it->first == szToken)
+		{
+			uEntry = it->second;
+			continue;
+		}
+
+		uint32_t uChild = (uint32_t)m_vEntries.size();
+		vChildren.emplace(it, szToken, uChild);
+		m_vEntries.emplace_back(); // invalidates vChildren, which is not used again
+
+		uEntry = uChild;
+	}
+
+	// a longer path added earlier is covered by this one now
+	m_vEntries[uEntry].m_bAll = true;
+	m_vEntries[uEntry].m_vChildren.clear();
+
+	return true;
+}
+
+bool Projection::Find(const Entry* pEntry, const utf8_t* pLabel, size_t uLength, const Entry*& pChild) const
+{
+	const auto& vChildren = pEntry->m_vChildren;
+
+	auto it = std::lower_bound(vChildren.begin(), vChildren.end(), uLength,
+							   [pLabel](const std::pair<std::string, uint32_t>& child, size_t uLabelLength)
+							   {
+								   return child.first.compare(0, std::string::npos, pLabel, uLabelLength) < 0;
+							   });
+
+	if (it == vChildren.end() || it->first.compare(0, std::string::npos, pLabel, uLength) != 0)
+		return false;
+
+	pChild = Resolve(it->second);
+	return true;
+}
+
+}
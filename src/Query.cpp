@@ -0,0 +1,386 @@
+#include <n2ajl/Query.h>
+#include "ByteTokenizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace n2ajl
+{
+
+// substring search that compares the first and last byte of szLiteral at 16 positions at once and only
+// runs memcmp where both agree
+static bool Contains(const utf8_t* p, size_t uLength, const std::string& szLiteral)
+{
+	size_t k = szLiteral.size();
+
+	if (!k)
+		return true;
+
+	if (k > uLength)
+		return false;
+
+	size_t i = 0;
+
+#if N2AJL_SSE2
+	const __m128i first = _mm_set1_epi8(szLiteral[0]);
+	const __m128i last = _mm_set1_epi8(szLiteral[k - 1]);
+
+	for (; i + k - 1 + 16 <= uLength; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(p + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(p + i + k - 1));
+		uint32_t uMask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+		while (uMask)
+		{
+			if (!memcmp(p + i + CountTrailingZeros(uMask), szLiteral.data(), k))
+				return true;
+
+			uMask &= uMask - 1;
+		}
+	}
+#endif
+
+	for (; i + k <= uLength; i++)
+	{
+		const utf8_t* pFirst = (const utf8_t*)memchr(p + i, szLiteral[0], uLength - k + 1 - i);
+		if (!pFirst)
+			return false;
+
+		i = pFirst - p;
+
+		if (!memcmp(pFirst, szLiteral.data(), k))
+			return true;
+	}
+
+	return false;
+}
+
+bool Query::MakePath(const char* szPath, Path& path)
+{
+	std::vector<std::string> vTokens;
+
+	if (!Projection::SplitPath(szPath, vTokens))
+		return false;
+
+	for (const std::string& szToken : vTokens)
+		path.m_vTokens.emplace_back(szToken.data(), szToken.size());
+
+	path.m_szPointer = szPath;
+	return true;
+}
+
+bool Query::Where(const char* szPath, Compare eCompare, const Node& value)
+{
+	Predicate predicate;
+
+	if (!MakePath(szPath, predicate.m_Path))
+		return false;
+
+	predicate.m_eCompare = eCompare;
+	predicate.m_Value = value;
+
+	// a predicate never holds without its path, so the label has to be on the line
+	if (!predicate.m_Path.m_vTokens.empty())
+	{
+		const utf8string& szLabel = predicate.m_Path.m_vTokens.back();
+		m_vLiterals.push_back('\"' + std::string(szLabel.data(), szLabel.size()) + '\"');
+	}
+
+	if (eCompare == Compare::Equal)
+	{
+		switch (value.GetType())
+		{
+			case Node::Type::String:
+				m_vLiterals.push_back('\"' + std::string(value.GetString().data(), value.GetString().size()) + '\"');
+				break;
+			case Node::Type::Boolean:
+				m_vLiterals.push_back(value.GetBool() ? "true" : "false");
+				break;
+			case Node::Type::Null:
+				m_vLiterals.push_back("null");
+				break;
+			default: break; // numbers have too many spellings
+		}
+	}
+
+	m_vPredicates.push_back(std::move(predicate));
+	return true;
+}
+
+bool Query::Select(const char* szPath)
+{
+	Path path;
+
+	if (!MakePath(szPath, path))
+		return false;
+
+	m_vSelected.push_back(std::move(path));
+	return true;
+}
+
+bool Query::Aggregate(Function eFunction, const char* szPath)
+{
+	Aggregation aggregation;
+
+	if (!MakePath(szPath, aggregation.m_Path))
+		return false;
+
+	aggregation.m_eFunction = eFunction;
+	m_vAggregations.push_back(std::move(aggregation));
+	return true;
+}
+
+void Query::Require(const char* szLiteral)
+{
+	m_vLiterals.push_back(szLiteral);
+}
+
+const Node* Query::Resolve(const Node& root, const Path& path)
+{
+	const Node* pNode = &root;
+
+	for (const utf8string& szToken : path.m_vTokens)
+	{
+		if (pNode->GetType() != Node::Type::Object)
+			return nullptr;
+
+		pNode = pNode->Get(szToken);
+
+		if (!pNode)
+			return nullptr;
+	}
+
+	return pNode;
+}
+
+bool Query::Test(const Predicate& predicate, const Node& root)
+{
+	const Node* pValue = Resolve(root, predicate.m_Path);
+
+	if (!pValue)
+		return false;
+
+	const Node& value = predicate.m_Value;
+	int iOrder = 0;
+
+	switch (predicate.m_eCompare)
+	{
+		case Compare::Exists:
+			return true;
+		case Compare::Equal:
+			return pValue->Equals(value);
+		case Compare::NotEqual:
+			return !pValue->Equals(value);
+		default:
+			break;
+	}
+
+	if (pValue->GetType() == Node::Type::Number && value.GetType() == Node::Type::Number)
+	{
+		if (pValue->GetNumber() != pValue->GetNumber() || value.GetNumber() != value.GetNumber())
+			return false; // NaN does not order
+
+		iOrder = pValue->GetNumber() < value.GetNumber() ? -1 : (pValue->GetNumber() > value.GetNumber() ? 1 : 0);
+	}
+	else if (pValue->GetType() == Node::Type::String && value.GetType() == Node::Type::String)
+	{
+		iOrder = pValue->GetString().compare(value.GetString());
+	}
+	else
+	{
+		return false;
+	}
+
+	switch (predicate.m_eCompare)
+	{
+		case Compare::Less:			return iOrder < 0;
+		case Compare::LessEqual:	return iOrder <= 0;
+		case Compare::Greater:		return iOrder > 0;
+		case Compare::GreaterEqual:	return iOrder >= 0;
+		default:					return false;
+	}
+}
+
+QueryResult Query::Run(const ParserConfig& cfg, const utf8_t* pData, size_t uLength, const MatchCallback& onMatch) const
+{
+	QueryResult result;
+
+	// only what the query looks at is built, unless whole lines are handed out
+	Projection projection;
+	ParserConfig lineCfg = cfg;
+	lineCfg.m_bReuseNodes = true;
+
+	if (!onMatch || !m_vSelected.empty())
+	{
+		for (const Predicate& predicate : m_vPredicates)
+			projection.Add(predicate.m_Path.m_szPointer.c_str());
+
+		for (const Path& path : m_vSelected)
+			projection.Add(path.m_szPointer.c_str());
+
+		for (const Aggregation& aggregation : m_vAggregations)
+			projection.Add(aggregation.m_Path.m_szPointer.c_str());
+
+		lineCfg.m_pProjection = &projection;
+	}
+
+	// the longest literals tend to reject the most lines, so they are searched first
+	std::vector<std::string> vLiterals = m_vLiterals;
+	std::sort(vLiterals.begin(), vLiterals.end(), [](const std::string& a, const std::string& b) { return a.size() > b.size(); });
+	vLiterals.erase(std::unique(vLiterals.begin(), vLiterals.end()), vLiterals.end());
+
+	struct Accumulator
+	{
+		size_t m_uCount = 0;
+		double m_dblSum = 0.0;
+		double m_dblMin = std::numeric_limits<double>::quiet_NaN();
+		double m_dblMax = std::numeric_limits<double>::quiet_NaN();
+	};
+
+	std::vector<Accumulator> vAccumulators(m_vAggregations.size());
+
+	std::string szLine; // Parse needs a terminated copy
+	Node line;
+	const utf8_t* pEnd = pData + uLength;
+
+	for (const utf8_t* p = pData; p < pEnd;)
+	{
+		const utf8_t* pLineEnd = (const utf8_t*)memchr(p, '\n', pEnd - p);
+		if (!pLineEnd)
+			pLineEnd = pEnd;
+
+		const utf8_t* pLine = p;
+		size_t uLineLength = pLineEnd - p;
+		p = pLineEnd + 1;
+
+		if (uLineLength && pLine[uLineLength - 1] == '\r')
+			uLineLength--;
+
+		bool bBlank = true;
+		for (size_t i = 0; i < uLineLength && bBlank; i++)
+			bBlank = pLine[i] == ' ' || pLine[i] == '\t';
+
+		if (bBlank)
+			continue;
+
+		result.m_uLines++;
+
+		bool bCandidate = true;
+		for (size_t i = 0; i < vLiterals.size() && bCandidate; i++)
+			bCandidate = Contains(pLine, uLineLength, vLiterals[i]);
+
+		if (!bCandidate)
+		{
+			result.m_uPrefiltered++;
+			continue;
+		}
+
+		szLine.assign(pLine, uLineLength);
+		result.m_uParsed++;
+
+		if (!Parse(lineCfg, szLine.c_str(), line).m_bSuccess)
+		{
+			result.m_uErrors++;
+			continue;
+		}
+
+		bool bMatch = true;
+		for (size_t i = 0; i < m_vPredicates.size() && bMatch; i++)
+			bMatch = Test(m_vPredicates[i], line);
+
+		if (!bMatch)
+			continue;
+
+		result.m_uMatched++;
+
+		for (size_t i = 0; i < m_vAggregations.size(); i++)
+		{
+			const Node* pValue = Resolve(line, m_vAggregations[i].m_Path);
+			Accumulator& acc = vAccumulators[i];
+
+			if (!pValue)
+				continue;
+
+			if (m_vAggregations[i].m_eFunction == Function::Count)
+			{
+				acc.m_uCount++;
+				continue;
+			}
+
+			if (pValue->GetType() != Node::Type::Number)
+				continue;
+
+			double dblValue = pValue->GetNumber();
+			acc.m_dblSum += dblValue;
+
+			if (!(dblValue >= acc.m_dblMin)) // also replaces the initial NaN
+				acc.m_dblMin = dblValue;
+
+			if (!(dblValue <= acc.m_dblMax))
+				acc.m_dblMax = dblValue;
+		}
+
+		if (!onMatch)
+			continue;
+
+		if (m_vSelected.empty())
+		{
+			onMatch(line);
+			continue;
+		}
+
+		// copies share storage with line, so this only links the selected values into a new root
+		Node selected = Node::Object();
+
+		for (const Path& path : m_vSelected)
+		{
+			const Node* pValue = Resolve(line, path);
+			if (!pValue)
+				continue;
+
+			if (path.m_vTokens.empty())
+			{
+				selected = *pValue;
+				break;
+			}
+
+			Node* pParent = &selected;
+
+			for (size_t i = 0; i + 1 < path.m_vTokens.size(); i++)
+			{
+				Node* pChild = pParent->Get(path.m_vTokens[i]);
+
+				if (!pChild || pChild->GetType() != Node::Type::Object)
+				{
+					pParent->Set(path.m_vTokens[i], Node::Object());
+					pChild = pParent->Get(path.m_vTokens[i]);
+				}
+
+				pParent = pChild;
+			}
+
+			pParent->Set(path.m_vTokens.back(), *pValue);
+		}
+
+		onMatch(selected);
+	}
+
+	for (size_t i = 0; i < m_vAggregations.size(); i++)
+	{
+		const Accumulator& acc = vAccumulators[i];
+
+		switch (m_vAggregations[i].m_eFunction)
+		{
+			case Function::Count:	result.m_vAggregates.push_back((double)acc.m_uCount); break;
+			case Function::Sum:		result.m_vAggregates.push_back(acc.m_dblSum); break;
+			case Function::Min:		result.m_vAggregates.push_back(acc.m_dblMin); break;
+			case Function::Max:		result.m_vAggregates.push_back(acc.m_dblMax); break;
+		}
+	}
+
+	return result;
+}
+
+}
@@ -0,0 +1,90 @@
+#include <n2ajl/Reclaimer.h>
+
+namespace n2ajl
+{
+
+Reclaimer::Reclaimer(bool bBackground)
+{
+	if (bBackground)
+		m_Thread = std::thread([this]() { WorkerMain(); });
+}
+
+Reclaimer::~Reclaimer()
+{
+	if (m_Thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_bStop = true;
+		}
+
+		m_Wake.notify_one();
+		m_Thread.join();
+	}
+
+	Drain();
+}
+
+void Reclaimer::Retire(Node&& json)
+{
+	bool bWasEmpty;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		bWasEmpty = m_vQueue.empty();
+		m_vQueue.push_back(std::move(json));
+	}
+
+	// the worker empties the whole queue once woken, later trees join the batch it takes next
+	if (bWasEmpty && m_Thread.joinable())
+		m_Wake.notify_one();
+}
+
+size_t Reclaimer::Drain()
+{
+	std::vector<Node> vBatch;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		vBatch.swap(m_vQueue);
+	}
+
+	size_t uFreed = vBatch.size();
+	vBatch.clear();
+
+	// hand the capacity back unless more was queued meanwhile
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_vQueue.empty())
+		vBatch.swap(m_vQueue);
+
+	return uFreed;
+}
+
+size_t Reclaimer::GetNumPending() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_vQueue.size();
+}
+
+void Reclaimer::WorkerMain()
+{
+	std::vector<Node> vBatch;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this]() { return m_bStop || !m_vQueue.empty(); });
+
+			// free what is queued before stopping
+			if (m_vQueue.empty())
+				return;
+
+			vBatch.swap(m_vQueue);
+		}
+
+		vBatch.clear();
+	}
+}
+
+}
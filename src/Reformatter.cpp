@@ -0,0 +1,349 @@
+#include <n2ajl/Reformatter.h>
+#include "ByteTokenizer.h"
+#include "SinkBuffer.h"
+
+namespace n2ajl
+{
+
+static const uint8_t s_uObject = 1;		// the span is an object, an array otherwise
+static const uint8_t s_uChildren = 2;	// a member or element was written, the next one needs a comma
+
+static const uint8_t s_Bom[3] = { 0xEF, 0xBB, 0xBF };
+
+Reformatter::Reformatter(const ParserConfig& parserCfg, const SerializerConfig& cfg, SerializeSink sink, size_t uBufferSize)
+	: m_Cfg(cfg), m_Sink(std::move(sink)), m_pOut(new SinkBuffer(m_Sink, uBufferSize)), m_uMaxDepth(parserCfg.m_uMaxDepth)
+{
+}
+
+Reformatter::~Reformatter() = default;
+
+bool Reformatter::Feed(const utf8_t* pData, size_t uLength)
+{
+	size_t i = 0;
+
+	while (i < uLength)
+	{
+		utf8_t ch = pData[i];
+
+		// strings and literals are copied in runs, everything else is one structural byte at a time
+		if (m_eState == State::String || m_eState == State::LabelString)
+		{
+			size_t uStart = i;
+
+			for (; i < uLength; i++)
+			{
+				ch = pData[i];
+
+				if (!ch)
+					return Fail(ErrorCode::UnexpectedEnd, m_uOffset + i);
+
+				if (m_bEscape)
+					m_bEscape = false;
+				else if (ch == '\\')
+					m_bEscape = true;
+				else if (ch == '\"')
+					break;
+			}
+
+			m_pOut->Write(pData + uStart, i - uStart);
+
+			if (i == uLength)
+				break; // the string goes on in the next chunk
+
+			m_pOut->Put('\"');
+			i++;
+
+			if (m_eState == State::LabelString)
+			{
+				if (m_uOffset + i == m_uTokenStart + 2) // nothing between the quotes
+					return Fail(ErrorCode::EmptyLabel, m_uTokenStart);
+
+				m_eState = State::Colon;
+			}
+			else
+			{
+				m_eState = State::AfterValue;
+			}
+
+			continue;
+		}
+
+		if (m_eState == State::Literal)
+		{
+			size_t uStart = i;
+
+			while (i < uLength && pData[i] && (uint8_t)pData[i] < 0x7F && !IsWhitespaceByte((uint8_t)pData[i]) && !IsTerminatorByte((uint8_t)pData[i]))
+				i++;
+
+			m_pOut->Write(pData + uStart, i - uStart);
+
+			if (i == uLength)
+				break;
+
+			if (!pData[i])
+				return Fail(ErrorCode::UnexpectedEnd, m_uOffset + i);
+
+			if ((uint8_t)pData[i] >= 0x7F)
+				return Fail(ErrorCode::UnexpectedCharacter, m_uOffset + i, (uint8_t)pData[i]);
+
+			m_eState = State::AfterValue;
+			continue; // the terminator is handled as structure
+		}
+
+		if (m_eState == State::Done)
+			break; // like Parse, whatever follows the root span is ignored
+
+		if (m_eState == State::Failed)
+			return false;
+
+		if (IsWhitespaceByte((uint8_t)ch))
+		{
+			i++;
+			continue;
+		}
+
+		// a BOM is only skipped at the very start of the stream
+		if (m_eState == State::Root && m_uOffset + i < 3 && (uint8_t)ch == s_Bom[m_uOffset + i])
+		{
+			i++;
+			continue;
+		}
+
+		// like Parse, a NUL ends the document; before the root span that leaves a null root
+		if (!ch && m_eState == State::Root)
+		{
+			NullRoot();
+			break;
+		}
+
+		if (!ch)
+			return Fail(ErrorCode::UnexpectedEnd, m_uOffset + i);
+
+		if ((uint8_t)ch >= 0x7F)
+			return Fail(ErrorCode::NonAscii, m_uOffset + i);
+
+		switch (m_eState)
+		{
+			case State::Root:
+				if (ch != '{' && ch != '[')
+					return Fail(ErrorCode::ExpectedSpan, m_uOffset + i, ch);
+
+				if (!OpenValue(ch, i))
+					return false;
+
+				break;
+			case State::Label:
+				if (ch == '}')
+				{
+					if (!Close(ch, i))
+						return false;
+
+					break;
+				}
+
+				if (ch != '\"')
+					return Fail(ErrorCode::ExpectedLabel, m_uOffset + i);
+
+				ChildPrefix();
+				m_pOut->Put('\"');
+
+				m_uTokenStart = m_uOffset + i;
+				m_bEscape = false;
+				m_eState = State::LabelString;
+				break;
+			case State::Colon:
+				if (ch != ':')
+					return Fail(ErrorCode::ExpectedColon, m_uOffset + i);
+
+				m_pOut->Put(':');
+
+				if (m_Cfg.m_bFancy)
+					m_pOut->Put(' ');
+
+				m_eState = State::Member;
+				break;
+			case State::Member:
+				if (!OpenValue(ch, i))
+					return false;
+
+				break;
+			case State::Element:
+				if (ch == ']')
+				{
+					if (!Close(ch, i))
+						return false;
+
+					break;
+				}
+
+				ChildPrefix();
+
+				if (!OpenValue(ch, i))
+					return false;
+
+				break;
+			case State::AfterValue:
+				if (ch == ',')
+				{
+					// the comma is written with the next child, which drops a trailing one
+					m_eState = (m_vSpans.back() & s_uObject) ? State::Label : State::Element;
+					break;
+				}
+
+				if (ch != '}' && ch != ']')
+					return Fail(ErrorCode::UnexpectedCharacter, m_uOffset + i, ch);
+
+				if (!Close(ch, i))
+					return false;
+
+				break;
+			default:
+				break;
+		}
+
+		// literals are not consumed here, their first character is copied with the rest
+		if (m_eState != State::Literal)
+			i++;
+	}
+
+	m_uOffset += uLength;
+	return true;
+}
+
+Result Reformatter::Finish()
+{
+	// only whitespace (or nothing) was fed, which Parse reads as a null root
+	if (m_eState == State::Root)
+		NullRoot();
+
+	if (m_eState != State::Done && m_eState != State::Failed)
+		Fail(ErrorCode::UnexpectedEnd, m_uOffset);
+
+	m_pOut->Flush();
+	return m_Result;
+}
+
+// at the first character of a value
+bool Reformatter::OpenValue(utf8_t ch, size_t i)
+{
+	// a span below the root counts against the limit as it does for Parse
+	if ((ch == '{' || ch == '[') && !m_vSpans.empty() && m_vSpans.size() >= m_uMaxDepth)
+		return Fail(ErrorCode::TooDeep, m_uOffset + i);
+
+	switch (ch)
+	{
+		case '{':
+			m_pOut->Put('{');
+			m_vSpans.push_back(s_uObject);
+			m_eState = State::Label;
+			return true;
+		case '[':
+			m_pOut->Put('[');
+			m_vSpans.push_back(0);
+			m_eState = State::Element;
+			return true;
+		case '\"':
+			m_pOut->Put('\"');
+			m_bEscape = false;
+			m_eState = State::String;
+			return true;
+		case ',':
+		case ']':
+		case '}':
+			return Fail(ErrorCode::UnexpectedCharacter, m_uOffset + i, ch); // an empty literal
+		default:
+			m_eState = State::Literal;
+			return true;
+	}
+}
+
+void Reformatter::NullRoot()
+{
+	m_pOut->Write("null", 4);
+	m_eState = State::Done;
+}
+
+bool Reformatter::Close(utf8_t ch, size_t i)
+{
+	uint8_t uSpan = m_vSpans.back();
+
+	if ((ch == '}') != ((uSpan & s_uObject) != 0))
+		return Fail(ErrorCode::UnexpectedCharacter, m_uOffset + i, ch);
+
+	m_vSpans.pop_back();
+
+	if (m_Cfg.m_bFancy && (uSpan & s_uChildren))
+	{
+		m_pOut->Put('\n');
+		Indent(m_vSpans.size());
+	}
+
+	m_pOut->Put(ch);
+
+	m_eState = m_vSpans.empty() ? State::Done : State::AfterValue;
+	return true;
+}
+
+// same layout as SerializeMemberPrefix and SerializeElementPrefix, the label itself follows
+void Reformatter::ChildPrefix()
+{
+	uint8_t& uSpan = m_vSpans.back();
+
+	if (uSpan & s_uChildren)
+		m_pOut->Put(',');
+
+	if (m_Cfg.m_bFancy)
+	{
+		if (uSpan & (s_uObject | s_uChildren))
+			m_pOut->Write(" \n", 2);
+		else
+			m_pOut->Put('\n');
+
+		Indent(m_vSpans.size());
+	}
+
+	uSpan |= s_uChildren;
+}
+
+void Reformatter::Indent(size_t uDepth)
+{
+	switch (m_Cfg.m_eIndentation)
+	{
+		case SerializerConfig::Indentation::FourSpace:
+			uDepth *= 4;
+			break;
+		case SerializerConfig::Indentation::TwoSpace:
+			uDepth *= 2;
+			break;
+		default: break;
+	}
+
+	utf8_t chIndent = m_Cfg.m_eIndentation == SerializerConfig::Indentation::Tab ? '\t' : ' ';
+
+	for (size_t i = 0; i < uDepth; i++)
+		m_pOut->Put(chIndent);
+}
+
+bool Reformatter::Fail(ErrorCode eError, uint64_t uOffset, uint32_t uChar)
+{
+	m_eState = State::Failed;
+
+	m_Result.m_bSuccess = false;
+	m_Result.m_eError = eError;
+	m_Result.m_uOffset = uOffset;
+	m_Result.m_uChar = uChar;
+
+	return false;
+}
+
+Result Reformat(const ParserConfig& parserCfg, const SerializerConfig& cfg, const utf8_t* pData, size_t uLength, utf8string& szOut)
+{
+	szOut.clear();
+
+	Reformatter reformatter(parserCfg, cfg, [&szOut](const utf8_t* pChunk, size_t uChunk) { szOut.append(pChunk, uChunk); });
+	reformatter.Feed(pData, uLength);
+
+	return reformatter.Finish();
+}
+
+}
@@ -0,0 +1,262 @@
+#include <n2ajl/Schema.h>
+#include <algorithm>
+#include <cmath>
+
+namespace n2ajl
+{
+
+static bool TypeBits(const Node& name, uint8_t& uTypes)
+{
+	if (name.GetType() != Node::Type::String)
+		return false;
+
+	static const struct { const char* m_szName; uint8_t m_uBits; } s_Types[] =
+	{
+		{ "null", 1 << (int)Node::Type::Null },
+		{ "boolean", 1 << (int)Node::Type::Boolean },
+		{ "number", 1 << (int)Node::Type::Number },
+		{ "integer", Schema::s_uInteger },
+		{ "string", 1 << (int)Node::Type::String },
+		{ "array", 1 << (int)Node::Type::Array },
+		{ "object", 1 << (int)Node::Type::Object },
+	};
+
+	for (const auto& type : s_Types)
+	{
+		if (name.GetString() == type.m_szName)
+		{
+			uTypes |= type.m_uBits;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool GetLimit(const Node& schema, const char* szKeyword, bool& bSet, double& dblLimit)
+{
+	const Node* pLimit = schema.Get(utf8string(szKeyword));
+	if (!pLimit)
+		return true;
+
+	if (pLimit->GetType() != Node::Type::Number)
+		return false;
+
+	bSet = true;
+	dblLimit = pLimit->GetNumber();
+	return true;
+}
+
+// appends the entry for schema (and those below it), uIndex is s_uAny for a schema accepting anything
+static bool CompileEntry(const Node& schema, std::vector<Schema::Entry>& vEntries, uint32_t& uIndex)
+{
+	if (schema.GetType() == Node::Type::Boolean)
+	{
+		uIndex = Schema::s_uAny;
+
+		if (!schema.GetBool())
+		{
+			uIndex = (uint32_t)vEntries.size();
+			vEntries.emplace_back();
+			vEntries.back().m_uTypes = 0;
+		}
+
+		return true;
+	}
+
+	if (schema.GetType() != Node::Type::Object)
+		return false;
+
+	// children are appended while this one is filled in, so it is built aside and moved in last
+	Schema::Entry entry;
+	bool bValid = true;
+
+	uIndex = (uint32_t)vEntries.size();
+	vEntries.emplace_back();
+
+	if (const Node* pType = schema.Get(utf8string("type")))
+	{
+		entry.m_uTypes = 0;
+
+		if (pType->GetType() == Node::Type::Array)
+			pType->ForEachElement([&](const Node& name) { bValid &= TypeBits(name, entry.m_uTypes); });
+		else
+			bValid &= TypeBits(*pType, entry.m_uTypes);
+	}
+
+	if (const Node* pEnum = schema.Get(utf8string("enum")))
+	{
+		if (pEnum->GetType() != Node::Type::Array)
+			return false;
+
+		pEnum->ForEachElement([&](const Node& value) { entry.m_vEnum.push_back(value); });
+	}
+
+	bValid &= GetLimit(schema, "minimum", entry.m_bMinimum, entry.m_dblMinimum);
+	bValid &= GetLimit(schema, "maximum", entry.m_bMaximum, entry.m_dblMaximum);
+
+	// the numeric form (draft 6 on), checked alongside the inclusive bounds
+	bValid &= GetLimit(schema, "exclusiveMinimum", entry.m_bExclusiveMinimum, entry.m_dblExclusiveMinimum);
+	bValid &= GetLimit(schema, "exclusiveMaximum", entry.m_bExclusiveMaximum, entry.m_dblExclusiveMaximum);
+
+	if (const Node* pProperties = schema.Get(utf8string("properties")))
+	{
+		if (pProperties->GetType() != Node::Type::Object)
+			return false;
+
+		pProperties->ForEachMember([&](const utf8nodestring& szLabel, const Node& property)
+		{
+			uint32_t uProperty = Schema::s_uAny;
+			bValid &= CompileEntry(property, vEntries, uProperty);
+
+			entry.m_vProperties.push_back({ std::string(szLabel.data(), szLabel.size()), uProperty, 0 });
+		});
+	}
+
+	if (const Node* pRequired = schema.Get(utf8string("required")))
+	{
+		if (pRequired->GetType() != Node::Type::Array || pRequired->Length() > 64)
+			return false;
+
+		uint64_t uBit = 1;
+
+		pRequired->ForEachElement([&](const Node& label)
+		{
+			if (label.GetType() != Node::Type::String)
+			{
+				bValid = false;
+				return;
+			}
+
+			const utf8nodestring& szLabel = label.GetString();
+			auto it = std::find_if(entry.m_vProperties.begin(), entry.m_vProperties.end(),
+								   [&](const Schema::Entry::Property& property) { return property.m_szLabel.compare(0, std::string::npos, szLabel.data(), szLabel.size()) == 0; });
+
+			// required but otherwise unconstrained
+			if (it == entry.m_vProperties.end())
+			{
+				entry.m_vProperties.push_back({ std::string(szLabel.data(), szLabel.size()), Schema::s_uAny, 0 });
+				it = entry.m_vProperties.end() - 1;
+			}
+
+			if (!it->m_uRequired) // listed twice
+			{
+				it->m_uRequired = uBit;
+				entry.m_uRequired |= uBit;
+				uBit <<= 1;
+			}
+		});
+	}
+
+	std::sort(entry.m_vProperties.begin(), entry.m_vProperties.end(),
+			  [](const Schema::Entry::Property& a, const Schema::Entry::Property& b) { return a.m_szLabel < b.m_szLabel; });
+
+	if (const Node* pItems = schema.Get(utf8string("items")))
+	{
+		if (pItems->GetType() == Node::Type::Array) // tuple validation is not supported
+			return false;
+
+		bValid &= CompileEntry(*pItems, vEntries, entry.m_uItems);
+	}
+
+	vEntries[uIndex] = std::move(entry);
+	return bValid;
+}
+
+bool Schema::Compile(const Node& schema)
+{
+	std::vector<Entry> vEntries;
+	uint32_t uRoot = s_uAny;
+
+	if (!CompileEntry(schema, vEntries, uRoot))
+		return false;
+
+	// a root accepting anything still needs an entry, GetRoot resolves the first one
+	if (uRoot == s_uAny)
+		vEntries.clear();
+
+	m_vEntries = std::move(vEntries);
+	return true;
+}
+
+const Schema::Entry* Schema::FindProperty(const Entry* pEntry, const utf8_t* pLabel, size_t uLength, uint64_t& uRequired) const
+{
+	uRequired = 0;
+
+	const auto& vProperties = pEntry->m_vProperties;
+
+	auto it = std::lower_bound(vProperties.begin(), vProperties.end(), uLength,
+							   [pLabel](const Entry::Property& property, size_t uLabelLength)
+							   {
+								   return property.m_szLabel.compare(0, std::string::npos, pLabel, uLabelLength) < 0;
+							   });
+
+	if (it == vProperties.end() || it->m_szLabel.compare(0, std::string::npos, pLabel, uLength) != 0)
+		return nullptr;
+
+	uRequired = it->m_uRequired;
+	return Resolve(it->m_uEntry);
+}
+
+ErrorCode Schema::CheckType(const Entry* pEntry, Node::Type eType) const
+{
+	if (!pEntry || (pEntry->m_uTypes & (1 << (int)eType)))
+		return ErrorCode::None;
+
+	return ErrorCode::SchemaType;
+}
+
+ErrorCode Schema::CheckValue(const Entry* pEntry, const Node& value) const
+{
+	if (!pEntry)
+		return ErrorCode::None;
+
+	Node::Type eType = value.GetType();
+
+	if (!(pEntry->m_uTypes & (1 << (int)eType)))
+	{
+		bool bInteger = eType == Node::Type::Number && (pEntry->m_uTypes & s_uInteger) &&
+						std::floor(value.GetNumber()) == value.GetNumber();
+
+		if (!bInteger)
+			return ErrorCode::SchemaType;
+	}
+
+	if (!pEntry->m_vEnum.empty())
+	{
+		bool bFound = false;
+
+		for (const Node& option : pEntry->m_vEnum)
+		{
+			if (option.Equals(value))
+			{
+				bFound = true;
+				break;
+			}
+		}
+
+		if (!bFound)
+			return ErrorCode::SchemaEnum;
+	}
+
+	if (eType == Node::Type::Number)
+	{
+		double dblValue = value.GetNumber();
+
+		if (pEntry->m_bMinimum && dblValue < pEntry->m_dblMinimum)
+			return ErrorCode::SchemaRange;
+
+		if (pEntry->m_bMaximum && dblValue > pEntry->m_dblMaximum)
+			return ErrorCode::SchemaRange;
+
+		if (pEntry->m_bExclusiveMinimum && dblValue <= pEntry->m_dblExclusiveMinimum)
+			return ErrorCode::SchemaRange;
+
+		if (pEntry->m_bExclusiveMaximum && dblValue >= pEntry->m_dblExclusiveMaximum)
+			return ErrorCode::SchemaRange;
+	}
+
+	return ErrorCode::None;
+}
+
+}
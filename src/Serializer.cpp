@@ -1,133 +1,382 @@
 #include <n2ajl/Serializer.h>
+#include <n2ajl/ThreadPool.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 
 namespace n2ajl
 {
 
-void SerializeNode(const Node& n, std::string& out, size_t depth, const SerializerConfig& cfg);
+// the disabled recorder is empty, SerializeRecorded<false> is the plain serializer
+template<bool bEnabled>
+class SerializeRecorder
+{
+public:
+	explicit SerializeRecorder(SerializerStats*) {}
+
+	void OnNode(Node::Type, size_t) {}
+	template<typename Writer>
+	void OnWrite(const Writer&) {}
+	void End(size_t, size_t) {}
+};
+
+template<>
+class SerializeRecorder<true>
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit SerializeRecorder(SerializerStats* pStats) : m_Stats(*pStats), m_Start(Clock::now())
+	{
+		m_Stats = SerializerStats();
+	}
+
+	void OnNode(Node::Type eType, size_t depth)
+	{
+		m_Stats.m_uNodes[(size_t)eType]++;
+
+		if ((eType == Node::Type::Array || eType == Node::Type::Object) && depth + 1 > m_Stats.m_uMaxDepth)
+			m_Stats.m_uMaxDepth = depth + 1;
+	}
+
+	// called after every node is written, growth is detected by watching the capacity
+	template<typename Writer>
+	void OnWrite(const Writer& out)
+	{
+		OnCapacity(out.GetCapacity());
+	}
+
+	void End(size_t uSize, size_t uCapacity)
+	{
+		OnCapacity(uCapacity);
+
+		m_Stats.m_uOutputBytes = uSize;
+		m_Stats.m_uNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_Start).count();
+	}
+
+private:
+	void OnCapacity(size_t uCapacity)
+	{
+		if (uCapacity != m_uCapacity)
+		{
+			m_uCapacity = uCapacity;
+			m_Stats.m_uReallocations++;
+		}
+	}
+
+	SerializerStats& m_Stats;
+	Clock::time_point m_Start;
+	size_t m_uCapacity = utf8string().capacity();
+};
+
+// output targets, every serializer function is written once against this interface;
+// WriteString receives string values, which a writer may reference instead of copying
+
+// appends to a string, growing it as needed
+class StringWriter
+{
+public:
+	explicit StringWriter(utf8string& out) : m_Out(out) {}
+
+	void Put(utf8_t ch) { m_Out += ch; }
+	void Write(const utf8_t* p, size_t uLength) { m_Out.append(p, uLength); }
+	void WriteString(const utf8_t* p, size_t uLength) { Write(p, uLength); }
+	void Fill(utf8_t ch, size_t uCount) { m_Out.append(uCount, ch); }
+	size_t GetCapacity() const { return m_Out.capacity(); }
+
+private:
+	utf8string& m_Out;
+};
 
-void SerializeBoolean(const Node& n, std::string& out)
+// only counts, the first pass of an exact size serialization
+class SizeWriter
 {
-	out += n.GetBool() ? "true" : "false";
+public:
+	void Put(utf8_t) { m_uSize++; }
+	void Write(const utf8_t*, size_t uLength) { m_uSize += uLength; }
+	void WriteString(const utf8_t* p, size_t uLength) { Write(p, uLength); }
+	void Fill(utf8_t, size_t uCount) { m_uSize += uCount; }
+	size_t GetCapacity() const { return 0; }
+	size_t GetSize() const { return m_uSize; }
+
+private:
+	size_t m_uSize = 0;
+};
+
+// writes into memory already known to be large enough, no checks
+class PointerWriter
+{
+public:
+	PointerWriter(utf8_t* pOut, size_t uCapacity) : m_pOut(pOut), m_uCapacity(uCapacity) {}
+
+	void Put(utf8_t ch) { *m_pOut++ = ch; }
+	void Write(const utf8_t* p, size_t uLength) { memcpy(m_pOut, p, uLength); m_pOut += uLength; }
+	void WriteString(const utf8_t* p, size_t uLength) { Write(p, uLength); }
+	void Fill(utf8_t ch, size_t uCount) { memset(m_pOut, ch, uCount); m_pOut += uCount; }
+	size_t GetCapacity() const { return m_uCapacity; }
+
+private:
+	utf8_t* m_pOut;
+	size_t m_uCapacity;
+};
+
+// writes while the output fits and keeps counting past the end, so one pass both fills and sizes
+class BoundedWriter
+{
+public:
+	BoundedWriter(utf8_t* pOut, size_t uCapacity) : m_pOut(pOut), m_uCapacity(uCapacity) {}
+
+	void Put(utf8_t ch)
+	{
+		if (m_uSize < m_uCapacity)
+			m_pOut[m_uSize] = ch;
+
+		m_uSize++;
+	}
+
+	void Write(const utf8_t* p, size_t uLength)
+	{
+		if (uLength <= m_uCapacity && m_uSize <= m_uCapacity - uLength)
+			memcpy(m_pOut + m_uSize, p, uLength);
+
+		m_uSize += uLength;
+	}
+
+	void WriteString(const utf8_t* p, size_t uLength) { Write(p, uLength); }
+
+	void Fill(utf8_t ch, size_t uCount)
+	{
+		if (uCount <= m_uCapacity && m_uSize <= m_uCapacity - uCount)
+			memset(m_pOut + m_uSize, ch, uCount);
+
+		m_uSize += uCount;
+	}
+
+	size_t GetCapacity() const { return m_uCapacity; }
+	size_t GetSize() const { return m_uSize; }
+
+private:
+	utf8_t* m_pOut;
+	size_t m_uCapacity;
+	size_t m_uSize = 0;
+};
+
+// copies into the scratch buffer of a GatherOutput and references long string values in place
+class GatherWriter
+{
+public:
+	GatherWriter(GatherOutput& out, size_t uMinReference) : m_Out(out), m_uMinReference(uMinReference)
+	{
+		m_Out.m_szScratch.clear();
+		m_Out.m_vSlices.clear();
+		m_Out.m_uSize = 0;
+	}
+
+	void Put(utf8_t ch) { m_Out.m_szScratch += ch; }
+	void Write(const utf8_t* p, size_t uLength) { m_Out.m_szScratch.append(p, uLength); }
+	void Fill(utf8_t ch, size_t uCount) { m_Out.m_szScratch.append(uCount, ch); }
+	size_t GetCapacity() const { return m_Out.m_szScratch.capacity(); }
+
+	void WriteString(const utf8_t* p, size_t uLength)
+	{
+		if (uLength < m_uMinReference)
+		{
+			Write(p, uLength);
+			return;
+		}
+
+		Flush();
+		m_Out.m_vSlices.push_back({ p, uLength });
+		m_Out.m_uSize += uLength;
+	}
+
+	// the scratch buffer may still move while writing, its slices get their pointers once it is complete
+	void Finish()
+	{
+		Flush();
+
+		const utf8_t* pScratch = m_Out.m_szScratch.data();
+
+		for (IoSlice& slice : m_Out.m_vSlices)
+		{
+			if (slice.m_pData)
+				continue;
+
+			slice.m_pData = pScratch;
+			pScratch += slice.m_uLength;
+		}
+	}
+
+private:
+	// closes the scratch bytes written since the last slice into a slice of their own
+	void Flush()
+	{
+		size_t uPending = m_Out.m_szScratch.size() - m_uFlushed;
+		if (!uPending)
+			return;
+
+		m_Out.m_vSlices.push_back({ nullptr, uPending });
+		m_Out.m_uSize += uPending;
+		m_uFlushed = m_Out.m_szScratch.size();
+	}
+
+	GatherOutput& m_Out;
+	size_t m_uMinReference;
+	size_t m_uFlushed = 0;
+};
+
+template<typename Writer, typename Recorder>
+void SerializeNode(const Node& n, Writer& out, size_t depth, const SerializerConfig& cfg, Recorder& rec);
+
+template<typename Writer>
+void SerializeBoolean(const Node& n, Writer& out)
+{
+	if (n.GetBool())
+		out.Write("true", 4);
+	else
+		out.Write("false", 5);
 }
 
-void SerializeNumber(const Node& n, std::string& out)
+template<typename Writer>
+void SerializeNumber(const Node& n, Writer& out)
 {
-	std::string str = std::to_string(n.GetNumber());
+	// same formatting as std::to_string, which is specified as "%f"; large enough for DBL_MAX
+	char szNumber[400];
+	int iLength = snprintf(szNumber, sizeof(szNumber), "%f", n.GetNumber());
 
-	if (str.find('.') != std::string::npos)
+	if (iLength < 0)
+		return;
+
+	size_t uLength = (size_t)iLength;
+
+	if (memchr(szNumber, '.', uLength))
 	{
 		// remove any trailing zeros
-		while (!str.empty() && *str.rbegin() == '0')
-			str.pop_back();
+		while (uLength && szNumber[uLength - 1] == '0')
+			uLength--;
 
 		// if the last position is a decimal point, strip it
-		if (str.size() > 1 && *str.rbegin() == '.')
-			str.pop_back();
+		if (uLength > 1 && szNumber[uLength - 1] == '.')
+			uLength--;
 	}
 
-	out += str;
+	out.Write(szNumber, uLength);
 }
 
-void Indent(const SerializerConfig& cfg, size_t depth, std::string& out)
+template<typename Writer>
+void Indent(const SerializerConfig& cfg, size_t depth, Writer& out)
 {
 	switch (cfg.m_eIndentation)
 	{
 		case SerializerConfig::Indentation::FourSpace:
-			for (size_t i = 0; i < depth * 4; i++)
-				out += ' ';
+			out.Fill(' ', depth * 4);
 			break;
 		case SerializerConfig::Indentation::TwoSpace:
-			for (size_t i = 0; i < depth * 2; i++)
-				out += ' ';
+			out.Fill(' ', depth * 2);
 			break;
 		case SerializerConfig::Indentation::Tab:
-			for (size_t i = 0; i < depth; i++)
-				out += '\t';
+			out.Fill('\t', depth);
 			break;
 		default: break;
 	}
 }
 
-void SerializeObject(const Node& n, std::string& out, size_t depth, const SerializerConfig& cfg)
-{
-	bool bFirst = true;
-	size_t uCount = 0;
+// the pieces of a span around its children, shared by the serial and the parallel serializer;
+// depth is the depth of the span itself
 
-	out += '{';
-
-	n.ForEachMember([&](const std::string& szLabel, const Node& member)
-					{
-						if (cfg.m_bFancy)
-							out += " \n";
-
-						if (cfg.m_bFancy)
-							Indent(cfg, depth + 1, out);
+template<typename Writer>
+void SerializeMemberPrefix(const utf8nodestring& szLabel, Writer& out, size_t depth, const SerializerConfig& cfg)
+{
+	if (cfg.m_bFancy)
+	{
+		out.Write(" \n", 2);
+		Indent(cfg, depth + 1, out);
+	}
 
-						out += '\"' + szLabel + "\":";
+	out.Put('\"');
+	out.Write(szLabel.data(), szLabel.size());
+	out.Write("\":", 2);
 
-						if (cfg.m_bFancy)
-							out += ' ';
+	if (cfg.m_bFancy)
+		out.Put(' ');
+}
 
-						SerializeNode(member, out, depth + 1, cfg);
-						uCount++;
+template<typename Writer>
+void SerializeElementPrefix(size_t uIndex, Writer& out, size_t depth, const SerializerConfig& cfg)
+{
+	if (!cfg.m_bFancy)
+		return;
 
-						if (uCount != n.GetNumMembers())
-							out += ',';
+	if (uIndex)
+		out.Write(" \n", 2);
+	else
+		out.Put('\n');
 
-						bFirst = false;
-					});
+	Indent(cfg, depth + 1, out);
+}
 
+template<typename Writer>
+void SerializeSpanEnd(utf8_t chEnd, size_t uCount, Writer& out, size_t depth, const SerializerConfig& cfg)
+{
 	if (cfg.m_bFancy && uCount)
 	{
-		out += '\n';
+		out.Put('\n');
 		Indent(cfg, depth, out);
 	}
 
-	out += '}';
+	out.Put(chEnd);
 }
 
-void SerializeArray(const Node& n, std::string& out, size_t depth, const SerializerConfig& cfg)
+template<typename Writer, typename Recorder>
+void SerializeObject(const Node& n, Writer& out, size_t depth, const SerializerConfig& cfg, Recorder& rec)
 {
-	bool bFirst = true;
+	size_t uTotal = n.GetNumMembers();
 	size_t uCount = 0;
 
-	out += '[';
+	out.Put('{');
 
-	n.ForEachElement([&](const Node& element)
-					{
-						if (!bFirst && cfg.m_bFancy)
-							out += ' ';
-
-						if (cfg.m_bFancy)
-							out += '\n';
+	for (const auto& member : n.members())
+	{
+		SerializeMemberPrefix(member.first, out, depth, cfg);
+		SerializeNode(member.second, out, depth + 1, cfg, rec);
 
-						if (cfg.m_bFancy)
-							Indent(cfg, depth + 1, out);
+		if (++uCount != uTotal)
+			out.Put(',');
+	}
 
-						SerializeNode(element, out, depth + 1, cfg);
-						uCount++;
+	SerializeSpanEnd('}', uCount, out, depth, cfg);
+}
 
-						if (uCount != n.Length())
-							out += ',';
+template<typename Writer, typename Recorder>
+void SerializeArray(const Node& n, Writer& out, size_t depth, const SerializerConfig& cfg, Recorder& rec)
+{
+	size_t uTotal = n.Length();
+	size_t uCount = 0;
 
-						bFirst = false;
-					});
+	out.Put('[');
 
-	if (cfg.m_bFancy && uCount)
+	for (const Node& element : n.elements())
 	{
-		out += '\n';
-		Indent(cfg, depth, out);
+		SerializeElementPrefix(uCount, out, depth, cfg);
+		SerializeNode(element, out, depth + 1, cfg, rec);
+
+		if (++uCount != uTotal)
+			out.Put(',');
 	}
 
-	out += ']';
+	SerializeSpanEnd(']', uCount, out, depth, cfg);
 }
 
-void SerializeNode(const Node& n, std::string& out, size_t depth, const SerializerConfig& cfg)
+template<typename Writer, typename Recorder>
+void SerializeNode(const Node& n, Writer& out, size_t depth, const SerializerConfig& cfg, Recorder& rec)
 {
+	rec.OnNode(n.GetType(), depth);
+
 	switch (n.GetType())
 	{
 		case Node::Type::Null:
-			out += "null";
+			out.Write("null", 4);
 			break;
 		case Node::Type::Boolean:
 			SerializeBoolean(n, out);
@@ -136,23 +385,422 @@ void SerializeNode(const Node& n, std::string& out, size_t depth, const Serializ
 			SerializeNumber(n, out);
 			break;
 		case Node::Type::String:
-			out += '\"' + n.GetString() + '\"';
+		{
+			// strings are stored with their escapes intact, so they are written as is
+			const utf8nodestring& szValue = n.GetString();
+
+			out.Put('\"');
+			out.WriteString(szValue.data(), szValue.size());
+			out.Put('\"');
 			break;
+		}
 		case Node::Type::Array:
-			SerializeArray(n, out, depth, cfg);
+			SerializeArray(n, out, depth, cfg, rec);
 			break;
 		case Node::Type::Object:
-			SerializeObject(n, out, depth, cfg);
+			SerializeObject(n, out, depth, cfg, rec);
 			break;
 	}
+
+	rec.OnWrite(out);
 }
 
-utf8string Serialize(const SerializerConfig& cfg, const Node& json)
+// exact size of the output, nothing is recorded
+size_t MeasureSerialized(const SerializerConfig& cfg, const Node& json)
 {
-	std::string out;
-	SerializeNode(json, out, 0, cfg);
+	SizeWriter size;
+	SerializeRecorder<false> rec(nullptr);
+
+	SerializeNode(json, size, 0, cfg, rec);
+	return size.GetSize();
+}
+
+// parallel serialization
+
+// a stretch of the output, written either by the splitter while walking the tree or by one pool task
+struct ParallelPiece
+{
+	utf8string m_szText;
+	SerializerStats m_Stats;
+	std::atomic<bool> m_bDone{ false };
+};
+
+// walks down large spans, writing their structure itself and handing runs of children to the pool;
+// runs are cut by child count, which balances best on arrays of similar records
+template<bool bStats>
+class ParallelSerializer
+{
+public:
+	static const size_t s_uMinRun = 32;		// children per task
+	static const size_t s_uMaxLevel = 8;	// spans deeper than this are serialized whole by one task
+
+	ParallelSerializer(const SerializerConfig& cfg, ThreadPool& pool)
+		: m_Cfg(cfg), m_Pool(pool), m_SplitRec(&m_SplitStats), m_Group(pool)
+	{
+		m_uTargetRuns = pool.GetNumThreads() * 4;
+	}
+
+	~ParallelSerializer()
+	{
+		m_Group.Wait();
+	}
+
+	void Split(const Node& root)
+	{
+		SplitNode(root, 0, 0);
+	}
+
+	// every piece in order, waiting for (and helping with) the ones still being written
+	template<typename Callback>
+	void Collect(Callback&& callback)
+	{
+		for (ParallelPiece& piece : m_Pieces)
+		{
+			while (!piece.m_bDone.load(std::memory_order_acquire))
+			{
+				if (m_Pool.RunPending())
+					continue;
+
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Done.wait_for(lock, std::chrono::milliseconds(1), [&piece]() { return piece.m_bDone.load(std::memory_order_acquire); });
+			}
+
+			callback(piece);
+		}
+	}
+
+	void MergeStats(SerializerStats& stats, size_t uOutputBytes)
+	{
+		auto Merge = [&stats](const SerializerStats& other)
+		{
+			for (size_t i = 0; i < 6; i++)
+				stats.m_uNodes[i] += other.m_uNodes[i];
+
+			stats.m_uReallocations += other.m_uReallocations;
+
+			if (other.m_uMaxDepth > stats.m_uMaxDepth)
+				stats.m_uMaxDepth = other.m_uMaxDepth;
+		};
+
+		Merge(m_SplitStats);
+
+		for (const ParallelPiece& piece : m_Pieces)
+			Merge(piece.m_Stats);
+
+		stats.m_uOutputBytes = uOutputBytes;
+	}
+
+private:
+	// the piece the splitter appends to, a new one follows every task
+	ParallelPiece& Text()
+	{
+		if (m_Pieces.empty() || !m_bTextOpen)
+		{
+			m_Pieces.emplace_back();
+			m_Pieces.back().m_bDone.store(true, std::memory_order_relaxed); // complete once Split returns
+			m_bTextOpen = true;
+		}
+
+		return m_Pieces.back();
+	}
+
+	template<typename Write>
+	void AddTask(Write&& write)
+	{
+		m_Pieces.emplace_back();
+		m_bTextOpen = false;
+
+		ParallelPiece* pPiece = &m_Pieces.back();
+
+		m_Group.Run([this, pPiece, write]()
+		{
+			SerializeRecorder<bStats> rec(&pPiece->m_Stats);
+			StringWriter out(pPiece->m_szText);
+
+			write(out, rec);
+			rec.End(pPiece->m_szText.size(), pPiece->m_szText.capacity());
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			pPiece->m_bDone.store(true, std::memory_order_release);
+			m_Done.notify_all();
+		});
+	}
+
+	// the run of children [uBegin, uEnd) of a span at depth, exactly as the serial serializer writes it
+	void AddRun(const std::vector<std::pair<const utf8nodestring*, const Node*>>* pChildren, bool bObject, size_t uBegin, size_t uEnd, size_t depth)
+	{
+		const SerializerConfig* pCfg = &m_Cfg;
+
+		AddTask([pChildren, bObject, uBegin, uEnd, depth, pCfg](StringWriter& out, SerializeRecorder<bStats>& rec)
+		{
+			const auto& children = *pChildren;
+
+			for (size_t i = uBegin; i < uEnd; i++)
+			{
+				if (bObject)
+					SerializeMemberPrefix(*children[i].first, out, depth, *pCfg);
+				else
+					SerializeElementPrefix(i, out, depth, *pCfg);
+
+				SerializeNode(*children[i].second, out, depth + 1, *pCfg, rec);
+
+				if (i + 1 != children.size())
+					out.Put(',');
+			}
+		});
+	}
+
+	void SplitNode(const Node& n, size_t depth, size_t uLevel)
+	{
+		bool bObject = n.GetType() == Node::Type::Object;
+
+		if (!bObject && n.GetType() != Node::Type::Array)
+		{
+			// scalars are cheap, the splitter writes them itself
+			StringWriter out(Text().m_szText);
+			SerializeNode(n, out, depth, m_Cfg, m_SplitRec);
+			return;
+		}
+
+		if (uLevel >= s_uMaxLevel)
+		{
+			const SerializerConfig* pCfg = &m_Cfg;
+			const Node* pNode = &n;
+
+			AddTask([pNode, depth, pCfg](StringWriter& out, SerializeRecorder<bStats>& rec)
+			{
+				SerializeNode(*pNode, out, depth, *pCfg, rec);
+			});
+
+			return;
+		}
+
+		m_Children.emplace_back();
+		auto& children = m_Children.back();
+
+		if (bObject)
+		{
+			for (const auto& member : n.members())
+				children.emplace_back(&member.first, &member.second);
+		}
+		else
+		{
+			for (const Node& element : n.elements())
+				children.emplace_back(nullptr, &element);
+		}
+
+		m_SplitRec.OnNode(n.GetType(), depth);
+		Text().m_szText += bObject ? '{' : '[';
+
+		size_t uCount = children.size();
+
+		if (uCount >= s_uMinRun * 2)
+		{
+			// enough children to split this span into runs
+			size_t uRuns = uCount / s_uMinRun;
+			if (uRuns > m_uTargetRuns)
+				uRuns = m_uTargetRuns;
+
+			size_t uPerRun = (uCount + uRuns - 1) / uRuns;
+
+			for (size_t i = 0; i < uCount; i += uPerRun)
+				AddRun(&children, bObject, i, i + uPerRun < uCount ? i + uPerRun : uCount, depth);
+		}
+		else
+		{
+			// few children, look for large spans further down
+			for (size_t i = 0; i < uCount; i++)
+			{
+				{
+					StringWriter out(Text().m_szText);
+
+					if (bObject)
+						SerializeMemberPrefix(*children[i].first, out, depth, m_Cfg);
+					else
+						SerializeElementPrefix(i, out, depth, m_Cfg);
+				}
+
+				SplitNode(*children[i].second, depth + 1, uLevel + 1);
+
+				if (i + 1 != uCount)
+					Text().m_szText += ',';
+			}
+		}
+
+		StringWriter out(Text().m_szText);
+		SerializeSpanEnd(bObject ? '}' : ']', uCount, out, depth, m_Cfg);
+	}
+
+	const SerializerConfig& m_Cfg;
+	ThreadPool& m_Pool;
+
+	std::deque<ParallelPiece> m_Pieces;	// never moves, tasks hold pointers into it
+	bool m_bTextOpen = false;
+
+	std::deque<std::vector<std::pair<const utf8nodestring*, const Node*>>> m_Children;	// of every split span
+	size_t m_uTargetRuns;
+
+	SerializerStats m_SplitStats;
+	SerializeRecorder<bStats> m_SplitRec; // nodes the splitter writes itself
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Done;
+
+	TaskGroup m_Group; // last, waited for before anything above is destroyed
+};
+
+template<bool bStats>
+utf8string SerializeParallelRecorded(const SerializerConfig& cfg, const Node& json, ThreadPool& pool)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	ParallelSerializer<bStats> serializer(cfg, pool);
+	serializer.Split(json);
+
+	// one allocation for the joined output, sized once every piece is known
+	std::vector<const ParallelPiece*> pieces;
+	size_t uSize = 0;
+
+	serializer.Collect([&](const ParallelPiece& piece)
+	{
+		pieces.push_back(&piece);
+		uSize += piece.m_szText.size();
+	});
+
+	utf8string out;
+	out.resize(uSize);
+
+	utf8_t* pOut = &out[0];
+	for (const ParallelPiece* pPiece : pieces)
+	{
+		memcpy(pOut, pPiece->m_szText.data(), pPiece->m_szText.size());
+		pOut += pPiece->m_szText.size();
+	}
+
+	if (bStats)
+	{
+		*cfg.m_pStats = SerializerStats();
+		serializer.MergeStats(*cfg.m_pStats, uSize);
+		cfg.m_pStats->m_uNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
 
 	return out;
 }
 
+template<bool bStats>
+void SerializeParallelRecorded(const SerializerConfig& cfg, const Node& json, ThreadPool& pool, const SerializeSink& sink)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	ParallelSerializer<bStats> serializer(cfg, pool);
+	serializer.Split(json);
+
+	size_t uSize = 0;
+
+	serializer.Collect([&](ParallelPiece& piece)
+	{
+		sink(piece.m_szText.data(), piece.m_szText.size());
+		uSize += piece.m_szText.size();
+
+		// handed over, only the stats are still needed
+		utf8string().swap(piece.m_szText);
+	});
+
+	if (bStats)
+	{
+		*cfg.m_pStats = SerializerStats();
+		serializer.MergeStats(*cfg.m_pStats, uSize);
+		cfg.m_pStats->m_uNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+template<bool bStats>
+utf8string SerializeRecorded(const SerializerConfig& cfg, const Node& json)
+{
+	SerializeRecorder<bStats> rec(cfg.m_pStats);
+
+	utf8string out;
+
+	if (cfg.m_bExactSize)
+	{
+		// the only allocation, the second pass cannot run out of room
+		out.resize(MeasureSerialized(cfg, json));
+
+		PointerWriter writer(&out[0], out.capacity());
+		SerializeNode(json, writer, 0, cfg, rec);
+	}
+	else
+	{
+		StringWriter writer(out);
+		SerializeNode(json, writer, 0, cfg, rec);
+	}
+
+	rec.End(out.size(), out.capacity());
+	return out;
+}
+
+template<bool bStats>
+size_t SerializeToRecorded(const SerializerConfig& cfg, const Node& json, utf8_t* pBuffer, size_t uCapacity)
+{
+	SerializeRecorder<bStats> rec(cfg.m_pStats);
+
+	BoundedWriter writer(pBuffer, uCapacity);
+	SerializeNode(json, writer, 0, cfg, rec);
+
+	rec.End(writer.GetSize(), uCapacity);
+	return writer.GetSize();
+}
+
+template<bool bStats>
+void SerializeGatherRecorded(const SerializerConfig& cfg, const Node& json, GatherOutput& out, size_t uMinReference)
+{
+	SerializeRecorder<bStats> rec(cfg.m_pStats);
+
+	GatherWriter writer(out, uMinReference);
+	SerializeNode(json, writer, 0, cfg, rec);
+	writer.Finish();
+
+	rec.End(out.GetSize(), writer.GetCapacity());
+}
+
+utf8string Serialize(const SerializerConfig& cfg, const Node& json)
+{
+	if (cfg.m_pStats)
+		return SerializeRecorded<true>(cfg, json);
+
+	return SerializeRecorded<false>(cfg, json);
+}
+
+size_t SerializeTo(const SerializerConfig& cfg, const Node& json, utf8_t* pBuffer, size_t uCapacity)
+{
+	if (cfg.m_pStats)
+		return SerializeToRecorded<true>(cfg, json, pBuffer, uCapacity);
+
+	return SerializeToRecorded<false>(cfg, json, pBuffer, uCapacity);
+}
+
+void SerializeGather(const SerializerConfig& cfg, const Node& json, GatherOutput& out, size_t uMinReference)
+{
+	if (cfg.m_pStats)
+		SerializeGatherRecorded<true>(cfg, json, out, uMinReference);
+	else
+		SerializeGatherRecorded<false>(cfg, json, out, uMinReference);
+}
+
+utf8string SerializeParallel(const SerializerConfig& cfg, const Node& json, ThreadPool& pool)
+{
+	if (cfg.m_pStats)
+		return SerializeParallelRecorded<true>(cfg, json, pool);
+
+	return SerializeParallelRecorded<false>(cfg, json, pool);
+}
+
+void SerializeParallel(const SerializerConfig& cfg, const Node& json, ThreadPool& pool, const SerializeSink& sink)
+{
+	if (cfg.m_pStats)
+		SerializeParallelRecorded<true>(cfg, json, pool, sink);
+	else
+		SerializeParallelRecorded<false>(cfg, json, pool, sink);
+}
+
 }
\ No newline at end of file
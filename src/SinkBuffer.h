@@ -0,0 +1,70 @@
+#pragma once
+
+// the buffered output shared by the transcoders and the Reformatter, not part of the public headers
+
+#include <n2ajl/Serializer.h>
+#include <cstring>
+#include <vector>
+
+namespace n2ajl
+{
+
+// a fixed output buffer in front of the sink, the only memory that grows with nothing but its size
+class SinkBuffer
+{
+public:
+	SinkBuffer(const SerializeSink& sink, size_t uSize) : m_Sink(sink), m_vBuffer(uSize ? uSize : 1) {}
+
+	void Put(uint8_t ch)
+	{
+		if (m_uUsed == m_vBuffer.size())
+			Flush();
+
+		m_vBuffer[m_uUsed++] = ch;
+	}
+
+	void Write(const void* pData, size_t uLength)
+	{
+		const uint8_t* p = (const uint8_t*)pData;
+
+		// long strings go straight to the sink instead of through the buffer
+		if (uLength >= m_vBuffer.size())
+		{
+			Flush();
+			m_Sink((const utf8_t*)p, uLength);
+			return;
+		}
+
+		if (uLength > m_vBuffer.size() - m_uUsed)
+			Flush();
+
+		memcpy(&m_vBuffer[m_uUsed], p, uLength);
+		m_uUsed += uLength;
+	}
+
+	// big-endian, as both formats store their lengths and numbers
+	void WriteBigEndian(uint64_t uValue, size_t uBytes)
+	{
+		uint8_t bytes[8];
+
+		for (size_t i = 0; i < uBytes; i++)
+			bytes[i] = (uint8_t)(uValue >> (8 * (uBytes - 1 - i)));
+
+		Write(bytes, uBytes);
+	}
+
+	void Flush()
+	{
+		if (m_uUsed)
+			m_Sink((const utf8_t*)m_vBuffer.data(), m_uUsed);
+
+		m_uUsed = 0;
+	}
+
+private:
+	const SerializeSink& m_Sink;
+	std::vector<uint8_t> m_vBuffer;
+	size_t m_uUsed = 0;
+};
+
+}
@@ -0,0 +1,133 @@
+#include <n2ajl/Snapshot.h>
+#include <cstdint>
+#include <cstdlib>
+
+namespace n2ajl
+{
+
+static const uint64_t uReaderBits = 16;
+static const uint64_t uReaderMask = (1ull << uReaderBits) - 1;
+
+// threads are numbered once, a reader uses the slot matching its number in every AtomicSnapshot
+static std::atomic<size_t> s_uNextThread{ 0 };
+thread_local size_t t_uThread = s_uNextThread.fetch_add(1, std::memory_order_relaxed);
+
+Snapshot Freeze(Node json)
+{
+	// computing every hash and member index now leaves nothing to be cached (written) by readers later
+	json.Hash();
+	json.BuildIndexes();
+
+	Snapshot snapshot;
+	snapshot.m_Root = std::move(json);
+
+	return snapshot;
+}
+
+AtomicSnapshot::ReadGuard::ReadGuard(ReadGuard&& other) noexcept
+{
+	m_pSlot = other.m_pSlot;
+	m_pSnapshot = other.m_pSnapshot;
+
+	other.m_pSlot = nullptr;
+	other.m_pSnapshot = nullptr;
+}
+
+AtomicSnapshot::ReadGuard::~ReadGuard()
+{
+	if (m_pSlot)
+		m_pSlot->fetch_sub(1, std::memory_order_release);
+}
+
+AtomicSnapshot::AtomicSnapshot(Snapshot initial, size_t uSlots)
+{
+	m_uSlots = uSlots ? uSlots : 1;
+	m_pSlotMemory = new char[(m_uSlots + 1) * sizeof(Slot)];
+	m_pSlots = (Slot*)(((uintptr_t)m_pSlotMemory + sizeof(Slot) - 1) & ~(uintptr_t)(sizeof(Slot) - 1));
+
+	for (size_t i = 0; i < m_uSlots; i++)
+		new(&m_pSlots[i].m_uState) std::atomic<uint64_t>(0);
+
+	m_pCurrent.store(new Snapshot(std::move(initial)), std::memory_order_release);
+}
+
+AtomicSnapshot::~AtomicSnapshot()
+{
+	for (const Retired& retired : m_vRetired)
+		delete retired.m_pSnapshot;
+
+	delete m_pCurrent.load(std::memory_order_acquire);
+	delete[] m_pSlotMemory;
+}
+
+AtomicSnapshot::ReadGuard AtomicSnapshot::Read() const
+{
+	std::atomic<uint64_t>& slot = m_pSlots[t_uThread % m_uSlots].m_uState;
+
+	// announce the epoch before loading the pointer, Publish retires only after bumping the epoch
+	uint64_t uEpoch = m_uEpoch.load(std::memory_order_seq_cst);
+	uint64_t uState = slot.load(std::memory_order_relaxed);
+	uint64_t uEntered;
+
+	do
+	{
+		if ((uState & uReaderMask) == uReaderMask)
+			std::abort(); // too many guards held on one slot
+
+		// a busy slot keeps the older epoch of the readers already in it
+		uEntered = (uState & uReaderMask) ? uState + 1 : (uEpoch << uReaderBits) | 1;
+	} while (!slot.compare_exchange_weak(uState, uEntered, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+	return ReadGuard(&slot, m_pCurrent.load(std::memory_order_seq_cst));
+}
+
+void AtomicSnapshot::Publish(Snapshot snapshot)
+{
+	const Snapshot* pNew = new Snapshot(std::move(snapshot));
+
+	std::lock_guard<std::mutex> lock(m_WriterMutex);
+
+	const Snapshot* pOld = m_pCurrent.exchange(pNew, std::memory_order_seq_cst);
+	uint64_t uEpoch = m_uEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+	m_vRetired.push_back({ pOld, uEpoch });
+	ReclaimLocked();
+}
+
+size_t AtomicSnapshot::Reclaim()
+{
+	std::lock_guard<std::mutex> lock(m_WriterMutex);
+	return ReclaimLocked();
+}
+
+size_t AtomicSnapshot::ReclaimLocked()
+{
+	if (m_vRetired.empty())
+		return 0;
+
+	// the oldest epoch any current reader entered with, readers from that epoch on never saw older snapshots
+	uint64_t uOldest = UINT64_MAX;
+
+	for (size_t i = 0; i < m_uSlots; i++)
+	{
+		uint64_t uState = m_pSlots[i].m_uState.load(std::memory_order_seq_cst);
+
+		if ((uState & uReaderMask) && (uState >> uReaderBits) < uOldest)
+			uOldest = uState >> uReaderBits;
+	}
+
+	size_t uKept = 0;
+
+	for (const Retired& retired : m_vRetired)
+	{
+		if (retired.m_uEpoch <= uOldest)
+			delete retired.m_pSnapshot;
+		else
+			m_vRetired[uKept++] = retired;
+	}
+
+	m_vRetired.resize(uKept);
+	return uKept;
+}
+
+}
@@ -0,0 +1,221 @@
+#include <n2ajl/Tape.h>
+#include "ByteTokenizer.h"
+
+namespace n2ajl
+{
+
+// the root of a document that holds nothing, before the first parse or after a failed one
+static const uint64_t s_uNullWord = 0; // Node::Type::Null, no payload
+
+// writes the tape as ByteTokenizer reads. while a span is open its word holds the index of the span
+// around it, so the open spans need no stack of their own
+struct TapeBuilder : NullHandler
+{
+	static const uint64_t s_uNone = (uint64_t(1) << NodeView::s_uTagShift) - 1;
+
+	explicit TapeBuilder(TapeDocument& doc) : m_vTape(doc.m_vTape), m_szStrings(doc.m_szStrings) {}
+
+	static uint64_t Word(uint64_t uTag, uint64_t uPayload) { return (uTag << NodeView::s_uTagShift) | uPayload; }
+	static uint64_t Word(Node::Type eType, uint64_t uPayload) { return Word((uint64_t)eType, uPayload); }
+
+	void OnBegin(bool bObject)
+	{
+		m_vTape.push_back(Word(bObject ? Node::Type::Object : Node::Type::Array, m_uOpen));
+		m_uOpen = m_vTape.size() - 1;
+	}
+
+	void OnEnd(bool bObject, size_t uCount)
+	{
+		// a document of nothing but whitespace ends without having begun, Parse makes that a null root
+		if (m_uOpen == s_uNone)
+		{
+			m_vTape.push_back(Word(Node::Type::Null, 0));
+			return;
+		}
+
+		size_t uOpen = m_uOpen;
+		m_uOpen = NodeView::GetPayload(m_vTape[uOpen]);
+		m_vTape.push_back(Word(NodeView::s_uEndTag, uCount));
+		m_vTape[uOpen] = Word(bObject ? Node::Type::Object : Node::Type::Array, m_vTape.size() - uOpen);
+	}
+
+	void OnLabel(const uint8_t* pLabel, size_t uLength)
+	{
+		PushString(NodeView::s_uLabelTag, pLabel, uLength);
+	}
+
+	void OnString(const uint8_t* pValue, size_t uLength)
+	{
+		PushString((uint64_t)Node::Type::String, pValue, uLength);
+	}
+
+	void OnNumber(const uint8_t* pValue, size_t /*uLength*/)
+	{
+		double dblValue = strtod((const char*)pValue, nullptr);
+		uint64_t uBits;
+		memcpy(&uBits, &dblValue, sizeof(uBits));
+
+		m_vTape.push_back(Word(Node::Type::Number, 0));
+		m_vTape.push_back(uBits);
+	}
+
+	void OnBoolean(bool bValue)
+	{
+		m_vTape.push_back(Word(Node::Type::Boolean, bValue));
+	}
+
+	void OnNull()
+	{
+		m_vTape.push_back(Word(Node::Type::Null, 0));
+	}
+
+	void PushString(uint64_t uTag, const uint8_t* p, size_t uLength)
+	{
+		m_vTape.push_back(Word(uTag, m_szStrings.size()));
+		m_vTape.push_back(uLength);
+		m_szStrings.append((const utf8_t*)p, uLength);
+		m_szStrings.push_back('\0');
+	}
+
+	std::vector<uint64_t, Allocator<uint64_t>>& m_vTape;
+	utf8nodestring& m_szStrings;
+	size_t m_uOpen = s_uNone;
+};
+
+TapeDocument::TapeDocument(MemoryResource* pResource) : m_vTape(Allocator<uint64_t>(pResource)), m_szStrings(Allocator<utf8_t>(pResource))
+{
+}
+
+Result TapeDocument::Parse(const ParserConfig& cfg, const utf8_t* pJson, size_t uLength)
+{
+	m_vTape.clear();
+	m_szStrings.clear();
+
+	// a string takes its bytes and a NUL against its bytes and quotes in the input. a span takes at most
+	// one word more than its bytes: only a number outweighs its text (two words for as little as one
+	// byte), and every element but the last pays that back with the comma after it
+	m_vTape.reserve(uLength + 1);
+	m_szStrings.reserve(uLength);
+
+	TapeBuilder builder(*this);
+	Result res = Tokenize(cfg, pJson, uLength, builder);
+
+	if (!res.m_bSuccess)
+	{
+		m_vTape.clear();
+		m_szStrings.clear();
+	}
+
+	return res;
+}
+
+NodeView TapeDocument::GetRoot() const
+{
+	if (m_vTape.empty())
+		return NodeView(&s_uNullWord, nullptr);
+
+	return NodeView(m_vTape.data(), m_szStrings.data());
+}
+
+double NodeView::GetNumber() const
+{
+	Check(Node::Type::Number);
+
+	double dblValue;
+	memcpy(&dblValue, &m_pWord[1], sizeof(dblValue));
+	return dblValue;
+}
+
+NodeView NodeView::Get(const Key& label) const
+{
+	Check(Node::Type::Object);
+
+	NodeView found;
+
+	for (const uint64_t* p = m_pWord + 1; GetTag(*p) == s_uLabelTag;)
+	{
+		NodeView member(p + 2, m_pStrings);
+
+		if ((size_t)p[1] == label.GetLength() && !memcmp(m_pStrings + GetPayload(p[0]), label.GetData(), label.GetLength()))
+			found = member;
+
+		p = member.GetNext();
+	}
+
+	return found;
+}
+
+bool NodeView::GetOrDefault(const Key& label, bool bDefault) const
+{
+	NodeView n = Get(label);
+	return n && n.GetType() == Node::Type::Boolean ? n.GetBool() : bDefault;
+}
+
+double NodeView::GetOrDefault(const Key& label, double dblDefault) const
+{
+	NodeView n = Get(label);
+	return n && n.GetType() == Node::Type::Number ? n.GetNumber() : dblDefault;
+}
+
+const utf8_t* NodeView::GetOrDefault(const Key& label, const utf8_t* szDefault) const
+{
+	NodeView n = Get(label);
+	return n && n.GetType() == Node::Type::String ? n.GetString() : szDefault;
+}
+
+NodeView NodeView::At(size_t i) const
+{
+	Check(Node::Type::Array);
+
+	const uint64_t* p = m_pWord + 1;
+
+	for (; i && GetTag(*p) != s_uEndTag; i--)
+		p = NodeView(p, m_pStrings).GetNext();
+
+	if (GetTag(*p) == s_uEndTag)
+		std::abort(); // out of range
+
+	return NodeView(p, m_pStrings);
+}
+
+Node::Type NodeView::GetElementType() const
+{
+	Check(Node::Type::Array);
+
+	// every element has the type of the first
+	return GetTag(m_pWord[1]) == s_uEndTag ? Node::Type::Null : (Node::Type)GetTag(m_pWord[1]);
+}
+
+Node NodeView::ToNode(MemoryResource* pResource) const
+{
+	switch (GetType())
+	{
+		case Node::Type::Boolean:
+			return Node(GetBool());
+
+		case Node::Type::Number:
+			return Node(GetNumber());
+
+		case Node::Type::String:
+			return Node(utf8nodestring(GetString(), GetStringLength(), Allocator<utf8_t>(pResource)));
+
+		case Node::Type::Array:
+		{
+			Node n = Node::Array(pResource);
+			ForEachElement([&](NodeView element) { n.Append(element.ToNode(pResource)); });
+			return n;
+		}
+
+		case Node::Type::Object:
+		{
+			Node n = Node::Object(pResource);
+			ForEachMember([&](const utf8_t* pLabel, size_t uLength, NodeView member) { n.Set(Key(pLabel, uLength), member.ToNode(pResource)); });
+			return n;
+		}
+
+		default:
+			return Node();
+	}
+}
+
+}
@@ -0,0 +1,115 @@
+#include <n2ajl/ThreadPool.h>
+#include <chrono>
+
+namespace n2ajl
+{
+
+ThreadPool::ThreadPool(size_t uThreads)
+{
+	if (!uThreads)
+		uThreads = std::thread::hardware_concurrency();
+
+	if (!uThreads)
+		uThreads = 1;
+
+	m_vThreads.reserve(uThreads);
+
+	for (size_t i = 0; i < uThreads; i++)
+		m_vThreads.emplace_back([this]() { WorkerMain(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStop = true;
+	}
+
+	m_Wake.notify_all();
+
+	for (std::thread& thread : m_vThreads)
+		thread.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Tasks.push_back(std::move(task));
+	}
+
+	m_Wake.notify_one();
+}
+
+bool ThreadPool::RunPending()
+{
+	std::function<void()> task;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Tasks.empty())
+			return false;
+
+		task = std::move(m_Tasks.front());
+		m_Tasks.pop_front();
+	}
+
+	task();
+	return true;
+}
+
+void ThreadPool::WorkerMain()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this]() { return m_bStop || !m_Tasks.empty(); });
+
+			// drain the queue before stopping
+			if (m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void TaskGroup::Run(std::function<void()> task)
+{
+	m_uPending.fetch_add(1, std::memory_order_relaxed);
+
+	m_Pool.Submit([this, task = std::move(task)]()
+	{
+		task();
+
+		// notify under the lock, Wait may return and destroy the group as soon as the count reaches zero
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_uPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			m_Done.notify_all();
+	});
+}
+
+void TaskGroup::Wait()
+{
+	while (m_uPending.load(std::memory_order_acquire))
+	{
+		// run whatever is queued, ours or not, instead of blocking a thread the pool may need
+		if (m_Pool.RunPending())
+			continue;
+
+		// the rest is running elsewhere, poll now and then in case more work is queued meanwhile
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Done.wait_for(lock, std::chrono::milliseconds(1), [this]() { return !m_uPending.load(std::memory_order_acquire); });
+	}
+
+	// a finishing task may still hold the lock after its decrement
+	std::lock_guard<std::mutex> lock(m_Mutex);
+}
+
+}
@@ -0,0 +1,956 @@
+#include <n2ajl/Transcoder.h>
+#include "ByteTokenizer.h"
+#include "SinkBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace n2ajl
+{
+
+static void AppendUTF8(std::string& szOut, uint32_t uCodepoint)
+{
+	if (uCodepoint < 0x80)
+	{
+		szOut += (char)uCodepoint;
+	}
+	else if (uCodepoint < 0x800)
+	{
+		szOut += (char)(0xC0 | (uCodepoint >> 6));
+		szOut += (char)(0x80 | (uCodepoint & 0x3F));
+	}
+	else if (uCodepoint < 0x10000)
+	{
+		szOut += (char)(0xE0 | (uCodepoint >> 12));
+		szOut += (char)(0x80 | ((uCodepoint >> 6) & 0x3F));
+		szOut += (char)(0x80 | (uCodepoint & 0x3F));
+	}
+	else
+	{
+		szOut += (char)(0xF0 | (uCodepoint >> 18));
+		szOut += (char)(0x80 | ((uCodepoint >> 12) & 0x3F));
+		szOut += (char)(0x80 | ((uCodepoint >> 6) & 0x3F));
+		szOut += (char)(0x80 | (uCodepoint & 0x3F));
+	}
+}
+
+static bool ReadHex4(const uint8_t* p, const uint8_t* pEnd, uint32_t& uValue)
+{
+	if (pEnd - p < 4)
+		return false;
+
+	uValue = 0;
+
+	for (size_t i = 0; i < 4; i++)
+	{
+		uint8_t ch = p[i];
+		uint32_t uDigit;
+
+		if (ch >= '0' && ch <= '9')
+			uDigit = ch - '0';
+		else if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')
+			uDigit = (ch | 0x20) - 'a' + 10;
+		else
+			return false;
+
+		uValue = (uValue << 4) | uDigit;
+	}
+
+	return true;
+}
+
+// decodes the escape sequences of a raw string. the tokenizer lets anything follow a backslash, an
+// unknown escape becomes the character itself and a broken \u sequence is kept as written
+static void Unescape(const uint8_t* p, size_t uLength, std::string& szOut)
+{
+	const uint8_t* pEnd = p + uLength;
+	szOut.clear();
+
+	while (p < pEnd)
+	{
+		const uint8_t* pEscape = (const uint8_t*)memchr(p, '\\', pEnd - p);
+		if (!pEscape)
+			pEscape = pEnd;
+
+		szOut.append((const char*)p, pEscape - p);
+		p = pEscape;
+
+		if (p + 1 >= pEnd)
+			break;
+
+		uint8_t ch = p[1];
+		p += 2;
+
+		switch (ch)
+		{
+			case 'b': szOut += '\b'; break;
+			case 'f': szOut += '\f'; break;
+			case 'n': szOut += '\n'; break;
+			case 'r': szOut += '\r'; break;
+			case 't': szOut += '\t'; break;
+			case 'u':
+			{
+				uint32_t uCodepoint;
+
+				if (!ReadHex4(p, pEnd, uCodepoint))
+				{
+					szOut += "\\u";
+					break;
+				}
+
+				p += 4;
+
+				if (uCodepoint >= 0xD800 && uCodepoint < 0xDC00)
+				{
+					uint32_t uLow;
+
+					if (pEnd - p >= 6 && p[0] == '\\' && p[1] == 'u' && ReadHex4(p + 2, pEnd, uLow) && uLow >= 0xDC00 && uLow < 0xE000)
+					{
+						uCodepoint = 0x10000 + ((uCodepoint - 0xD800) << 10) + (uLow - 0xDC00);
+						p += 6;
+					}
+					else
+					{
+						uCodepoint = 0xFFFD;
+					}
+				}
+				else if (uCodepoint >= 0xDC00 && uCodepoint < 0xE000)
+				{
+					uCodepoint = 0xFFFD;
+				}
+
+				AppendUTF8(szOut, uCodepoint);
+				break;
+			}
+			default:
+				szOut += (char)ch; // quote, backslash, solidus and anything else
+				break;
+		}
+	}
+}
+
+// true for an integer literal that fits 64 bits; -0 is left to be a double
+static bool ParseInteger(const uint8_t* p, size_t uLength, bool& bNegative, uint64_t& uMagnitude)
+{
+	const uint8_t* pEnd = p + uLength;
+
+	bNegative = p < pEnd && *p == '-';
+	if (bNegative)
+		p++;
+
+	if (p == pEnd || pEnd - p > 20)
+		return false;
+
+	uMagnitude = 0;
+
+	for (; p < pEnd; p++)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+
+		uint64_t uDigit = *p - '0';
+
+		if (uMagnitude > (UINT64_MAX - uDigit) / 10)
+			return false;
+
+		uMagnitude = uMagnitude * 10 + uDigit;
+	}
+
+	if (bNegative)
+		return uMagnitude && uMagnitude <= (uint64_t)INT64_MAX + 1;
+
+	return true;
+}
+
+static uint64_t DoubleBits(double dblValue)
+{
+	uint64_t uBits;
+	memcpy(&uBits, &dblValue, sizeof(uBits));
+	return uBits;
+}
+
+// records the member or element count of every span in the order they open, MessagePack's first pass
+class SpanCounter : public NullHandler
+{
+public:
+	void OnBegin(bool)
+	{
+		m_vOpen.push_back(m_vCounts.size());
+		m_vCounts.push_back(0);
+	}
+
+	void OnEnd(bool, size_t uCount)
+	{
+		// a document of nothing but whitespace ends without having begun, both encoders write nil for it
+		if (m_vOpen.empty())
+			return;
+
+		m_vCounts[m_vOpen.back()] = (uint32_t)uCount;
+		m_vOpen.pop_back();
+	}
+
+	std::vector<uint32_t> m_vCounts;
+
+private:
+	std::vector<size_t> m_vOpen;
+};
+
+class MessagePackEncoder : public NullHandler
+{
+public:
+	MessagePackEncoder(SinkBuffer& out, const std::vector<uint32_t>& vCounts) : m_Out(out), m_vCounts(vCounts) {}
+
+	void OnBegin(bool bObject)
+	{
+		uint32_t uCount = m_vCounts[m_uSpan++];
+		m_uDepth++;
+
+		if (uCount < 16)
+		{
+			m_Out.Put((uint8_t)((bObject ? 0x80 : 0x90) | uCount));
+		}
+		else if (uCount <= 0xFFFF)
+		{
+			m_Out.Put(bObject ? 0xDE : 0xDC);
+			m_Out.WriteBigEndian(uCount, 2);
+		}
+		else
+		{
+			m_Out.Put(bObject ? 0xDF : 0xDD);
+			m_Out.WriteBigEndian(uCount, 4);
+		}
+	}
+
+	void OnEnd(bool, size_t)
+	{
+		if (!m_uDepth)
+			OnNull();
+		else
+			m_uDepth--;
+	}
+
+	void OnLabel(const uint8_t* p, size_t uLength) { OnString(p, uLength); }
+
+	void OnString(const uint8_t* p, size_t uLength)
+	{
+		if (memchr(p, '\\', uLength))
+		{
+			Unescape(p, uLength, m_szScratch);
+			p = (const uint8_t*)m_szScratch.data();
+			uLength = m_szScratch.size();
+		}
+
+		if (uLength < 32)
+		{
+			m_Out.Put((uint8_t)(0xA0 | uLength));
+		}
+		else if (uLength <= 0xFF)
+		{
+			m_Out.Put(0xD9);
+			m_Out.Put((uint8_t)uLength);
+		}
+		else if (uLength <= 0xFFFF)
+		{
+			m_Out.Put(0xDA);
+			m_Out.WriteBigEndian(uLength, 2);
+		}
+		else
+		{
+			m_Out.Put(0xDB);
+			m_Out.WriteBigEndian(uLength, 4);
+		}
+
+		m_Out.Write(p, uLength);
+	}
+
+	void OnNumber(const uint8_t* p, size_t uLength)
+	{
+		bool bNegative;
+		uint64_t uMagnitude;
+
+		if (!ParseInteger(p, uLength, bNegative, uMagnitude))
+		{
+			m_Out.Put(0xCB);
+			m_Out.WriteBigEndian(DoubleBits(strtod((const char*)p, nullptr)), 8);
+		}
+		else if (!bNegative)
+		{
+			if (uMagnitude < 0x80)
+				m_Out.Put((uint8_t)uMagnitude);
+			else if (uMagnitude <= 0xFF)
+				WriteTyped(0xCC, uMagnitude, 1);
+			else if (uMagnitude <= 0xFFFF)
+				WriteTyped(0xCD, uMagnitude, 2);
+			else if (uMagnitude <= 0xFFFFFFFF)
+				WriteTyped(0xCE, uMagnitude, 4);
+			else
+				WriteTyped(0xCF, uMagnitude, 8);
+		}
+		else
+		{
+			// two's complement of the magnitude, truncated to the width chosen
+			uint64_t uValue = ~uMagnitude + 1;
+
+			if (uMagnitude <= 32)
+				m_Out.Put((uint8_t)uValue);
+			else if (uMagnitude <= 0x80)
+				WriteTyped(0xD0, uValue, 1);
+			else if (uMagnitude <= 0x8000)
+				WriteTyped(0xD1, uValue, 2);
+			else if (uMagnitude <= 0x80000000)
+				WriteTyped(0xD2, uValue, 4);
+			else
+				WriteTyped(0xD3, uValue, 8);
+		}
+	}
+
+	void OnBoolean(bool bValue) { m_Out.Put(bValue ? 0xC3 : 0xC2); }
+	void OnNull() { m_Out.Put(0xC0); }
+
+private:
+	void WriteTyped(uint8_t uType, uint64_t uValue, size_t uBytes)
+	{
+		m_Out.Put(uType);
+		m_Out.WriteBigEndian(uValue, uBytes);
+	}
+
+	SinkBuffer& m_Out;
+	const std::vector<uint32_t>& m_vCounts;
+	size_t m_uSpan = 0;
+	size_t m_uDepth = 0;
+	std::string m_szScratch;
+};
+
+class CborEncoder : public NullHandler
+{
+public:
+	explicit CborEncoder(SinkBuffer& out) : m_Out(out) {}
+
+	// the length is not known when a span opens, so it is written as an indefinite one ended by a break
+	void OnBegin(bool bObject)
+	{
+		m_Out.Put(bObject ? 0xBF : 0x9F);
+		m_uDepth++;
+	}
+
+	// an end with nothing open is a whitespace-only document, a null root
+	void OnEnd(bool, size_t)
+	{
+		if (!m_uDepth)
+		{
+			OnNull();
+			return;
+		}
+
+		m_Out.Put(0xFF);
+		m_uDepth--;
+	}
+
+	void OnLabel(const uint8_t* p, size_t uLength) { OnString(p, uLength); }
+
+	void OnString(const uint8_t* p, size_t uLength)
+	{
+		if (memchr(p, '\\', uLength))
+		{
+			Unescape(p, uLength, m_szScratch);
+			p = (const uint8_t*)m_szScratch.data();
+			uLength = m_szScratch.size();
+		}
+
+		WriteHead(3, uLength);
+		m_Out.Write(p, uLength);
+	}
+
+	void OnNumber(const uint8_t* p, size_t uLength)
+	{
+		bool bNegative;
+		uint64_t uMagnitude;
+
+		if (!ParseInteger(p, uLength, bNegative, uMagnitude))
+		{
+			m_Out.Put(0xFB);
+			m_Out.WriteBigEndian(DoubleBits(strtod((const char*)p, nullptr)), 8);
+		}
+		else if (bNegative)
+		{
+			WriteHead(1, uMagnitude - 1);
+		}
+		else
+		{
+			WriteHead(0, uMagnitude);
+		}
+	}
+
+	void OnBoolean(bool bValue) { m_Out.Put(bValue ? 0xF5 : 0xF4); }
+	void OnNull() { m_Out.Put(0xF6); }
+
+private:
+	void WriteHead(uint8_t uMajor, uint64_t uValue)
+	{
+		uMajor <<= 5;
+
+		if (uValue < 24)
+		{
+			m_Out.Put((uint8_t)(uMajor | uValue));
+		}
+		else if (uValue <= 0xFF)
+		{
+			m_Out.Put(uMajor | 24);
+			m_Out.Put((uint8_t)uValue);
+		}
+		else if (uValue <= 0xFFFF)
+		{
+			m_Out.Put(uMajor | 25);
+			m_Out.WriteBigEndian(uValue, 2);
+		}
+		else if (uValue <= 0xFFFFFFFF)
+		{
+			m_Out.Put(uMajor | 26);
+			m_Out.WriteBigEndian(uValue, 4);
+		}
+		else
+		{
+			m_Out.Put(uMajor | 27);
+			m_Out.WriteBigEndian(uValue, 8);
+		}
+	}
+
+	SinkBuffer& m_Out;
+	size_t m_uDepth = 0;
+	std::string m_szScratch;
+};
+
+Result JsonToBinary(BinaryFormat eFormat, const ParserConfig& cfg, const utf8_t* pJson, size_t uLength, const SerializeSink& sink, size_t uBufferSize)
+{
+	SinkBuffer out(sink, uBufferSize);
+	Result res;
+
+	if (eFormat == BinaryFormat::CBOR)
+	{
+		CborEncoder encoder(out);
+		res = Tokenize(cfg, pJson, uLength, encoder);
+	}
+	else
+	{
+		SpanCounter counter;
+		res = Tokenize(cfg, pJson, uLength, counter);
+
+		if (!res.m_bSuccess)
+			return res;
+
+		// the document is known to be valid now, the second pass cannot fail
+		MessagePackEncoder encoder(out, counter.m_vCounts);
+		Tokenize(cfg, pJson, uLength, encoder);
+	}
+
+	out.Flush();
+	return res;
+}
+
+Result JsonToBinary(BinaryFormat eFormat, const ParserConfig& cfg, const utf8_t* pJson, size_t uLength, utf8string& szOut)
+{
+	szOut.clear();
+	return JsonToBinary(eFormat, cfg, pJson, uLength, [&szOut](const utf8_t* pData, size_t uSize) { szOut.append(pData, uSize); });
+}
+
+// reads one item of either format and writes it as JSON
+class BinaryDecoder
+{
+public:
+	BinaryDecoder(BinaryFormat eFormat, const uint8_t* p, const uint8_t* pEnd, size_t uMaxDepth, SinkBuffer& out) :
+		m_eFormat(eFormat), m_p(p), m_pEnd(pEnd), m_uMaxDepth(uMaxDepth), m_Out(out) {}
+
+	bool Document()
+	{
+		if (!Item(0, false))
+			return false;
+
+		if (m_p != m_pEnd)
+			return Fail(ErrorCode::BadEncoding, m_p);
+
+		return true;
+	}
+
+	ErrorCode m_eError = ErrorCode::None;
+	const uint8_t* m_pError = nullptr;
+
+private:
+	bool Fail(ErrorCode eError, const uint8_t* pAt)
+	{
+		m_eError = eError;
+		m_pError = pAt;
+		return false;
+	}
+
+	bool ReadBigEndian(size_t uBytes, uint64_t& uValue)
+	{
+		if ((size_t)(m_pEnd - m_p) < uBytes)
+			return Fail(ErrorCode::UnexpectedEnd, m_pEnd);
+
+		uValue = 0;
+
+		for (size_t i = 0; i < uBytes; i++)
+			uValue = (uValue << 8) | m_p[i];
+
+		m_p += uBytes;
+		return true;
+	}
+
+	// a map key is written as a string, so integers are quoted and anything else is refused
+	bool Item(size_t uDepth, bool bKey)
+	{
+		if (m_p >= m_pEnd)
+			return Fail(ErrorCode::UnexpectedEnd, m_p);
+
+		return m_eFormat == BinaryFormat::CBOR ? CborItem(uDepth, bKey) : MessagePackItem(uDepth, bKey);
+	}
+
+	bool MessagePackItem(size_t uDepth, bool bKey)
+	{
+		const uint8_t* pItem = m_p;
+		uint8_t uType = *m_p++;
+		uint64_t uValue = 0;
+
+		if (uType < 0x80)
+			return Integer(false, uType, bKey);
+
+		if (uType >= 0xE0)
+			return Integer(true, 0x100 - uType, bKey);
+
+		if (uType >= 0xA0 && uType < 0xC0)
+			return String(uType & 0x1F);
+
+		if (uType < 0xA0)
+		{
+			bool bObject = uType < 0x90;
+			return Span(bObject, uType & 0x0F, uDepth, bKey, pItem);
+		}
+
+		switch (uType)
+		{
+			case 0xC0:
+			case 0xC2:
+			case 0xC3:
+				if (bKey)
+					return Fail(ErrorCode::BadEncoding, pItem);
+
+				if (uType == 0xC0)
+					m_Out.Write("null", 4);
+				else if (uType == 0xC3)
+					m_Out.Write("true", 4);
+				else
+					m_Out.Write("false", 5);
+
+				return true;
+			case 0xCA:
+			case 0xCB:
+			{
+				if (bKey)
+					return Fail(ErrorCode::BadEncoding, pItem);
+
+				if (!ReadBigEndian(uType == 0xCA ? 4 : 8, uValue))
+					return false;
+
+				if (uType == 0xCA)
+				{
+					uint32_t uBits = (uint32_t)uValue;
+					float fltValue;
+					memcpy(&fltValue, &uBits, sizeof(fltValue));
+					return Number(fltValue);
+				}
+
+				double dblValue;
+				memcpy(&dblValue, &uValue, sizeof(dblValue));
+				return Number(dblValue);
+			}
+			case 0xCC:
+			case 0xCD:
+			case 0xCE:
+			case 0xCF:
+				return ReadBigEndian((size_t)1 << (uType - 0xCC), uValue) && Integer(false, uValue, bKey);
+			case 0xD0:
+			case 0xD1:
+			case 0xD2:
+			case 0xD3:
+			{
+				size_t uBytes = (size_t)1 << (uType - 0xD0);
+
+				if (!ReadBigEndian(uBytes, uValue))
+					return false;
+
+				// sign extend, then split into sign and magnitude
+				size_t uShift = 64 - 8 * uBytes;
+				int64_t iValue = (int64_t)(uValue << uShift) >> uShift;
+
+				return iValue < 0 ? Integer(true, ~(uint64_t)iValue + 1, bKey) : Integer(false, (uint64_t)iValue, bKey);
+			}
+			case 0xD9:
+			case 0xDA:
+			case 0xDB:
+				return ReadBigEndian((size_t)1 << (uType - 0xD9), uValue) && String(uValue);
+			case 0xDC:
+			case 0xDD:
+				return ReadBigEndian(uType == 0xDC ? 2 : 4, uValue) && Span(false, uValue, uDepth, bKey, pItem);
+			case 0xDE:
+			case 0xDF:
+				return ReadBigEndian(uType == 0xDE ? 2 : 4, uValue) && Span(true, uValue, uDepth, bKey, pItem);
+			default:
+				return Fail(ErrorCode::BadEncoding, pItem); // binary, extensions and the unused 0xC1
+		}
+	}
+
+	// the argument of a CBOR head, uInfo 31 (indefinite) is left to the caller
+	bool CborArgument(uint8_t uInfo, const uint8_t* pItem, uint64_t& uValue)
+	{
+		if (uInfo < 24)
+		{
+			uValue = uInfo;
+			return true;
+		}
+
+		if (uInfo > 27)
+			return Fail(ErrorCode::BadEncoding, pItem);
+
+		return ReadBigEndian((size_t)1 << (uInfo - 24), uValue);
+	}
+
+	bool CborItem(size_t uDepth, bool bKey)
+	{
+		const uint8_t* pItem = m_p;
+		uint8_t uMajor = *m_p >> 5;
+		uint8_t uInfo = *m_p & 0x1F;
+		uint64_t uValue = 0;
+
+		m_p++;
+
+		// tags only annotate the item that follows
+		while (uMajor == 6)
+		{
+			if (!CborArgument(uInfo, pItem, uValue))
+				return false;
+
+			if (m_p >= m_pEnd)
+				return Fail(ErrorCode::UnexpectedEnd, m_p);
+
+			pItem = m_p;
+			uMajor = *m_p >> 5;
+			uInfo = *m_p & 0x1F;
+			m_p++;
+		}
+
+		bool bIndefinite = uInfo == 31;
+
+		if (uMajor == 7)
+			return CborSimple(uInfo, pItem, bKey);
+
+		if (bIndefinite)
+		{
+			if (uMajor < 2)
+				return Fail(ErrorCode::BadEncoding, pItem);
+		}
+		else if (!CborArgument(uInfo, pItem, uValue))
+		{
+			return false;
+		}
+
+		switch (uMajor)
+		{
+			case 0:
+				return Integer(false, uValue, bKey);
+			case 1:
+				// -1 - uValue, whose magnitude only overflows for the very last value
+				if (uValue == UINT64_MAX)
+				{
+					if (bKey)
+						m_Out.Put('\"');
+
+					m_Out.Write("-18446744073709551616", 21);
+
+					if (bKey)
+						m_Out.Put('\"');
+
+					return true;
+				}
+
+				return Integer(true, uValue + 1, bKey);
+			case 3:
+				if (!bIndefinite)
+					return String(uValue);
+
+				return CborChunkedString();
+			case 4:
+			case 5:
+				if (bIndefinite)
+					return Span(uMajor == 5, 0, uDepth, bKey, pItem, true);
+
+				return Span(uMajor == 5, uValue, uDepth, bKey, pItem);
+			default:
+				return Fail(ErrorCode::BadEncoding, pItem); // byte strings
+		}
+	}
+
+	bool CborSimple(uint8_t uInfo, const uint8_t* pItem, bool bKey)
+	{
+		uint64_t uValue = 0;
+
+		if (bKey)
+			return Fail(ErrorCode::BadEncoding, pItem);
+
+		switch (uInfo)
+		{
+			case 20:
+				m_Out.Write("false", 5);
+				return true;
+			case 21:
+				m_Out.Write("true", 4);
+				return true;
+			case 22:
+			case 23: // undefined
+				m_Out.Write("null", 4);
+				return true;
+			case 25:
+			{
+				if (!ReadBigEndian(2, uValue))
+					return false;
+
+				// half precision
+				int iExponent = (int)((uValue >> 10) & 0x1F);
+				double dblMantissa = (double)(uValue & 0x3FF);
+				double dblValue;
+
+				if (iExponent == 0)
+					dblValue = std::ldexp(dblMantissa, -24);
+				else if (iExponent == 31)
+					dblValue = dblMantissa ? NAN : INFINITY;
+				else
+					dblValue = std::ldexp(dblMantissa + 1024, iExponent - 25);
+
+				return Number(uValue & 0x8000 ? -dblValue : dblValue);
+			}
+			case 26:
+			{
+				if (!ReadBigEndian(4, uValue))
+					return false;
+
+				uint32_t uBits = (uint32_t)uValue;
+				float fltValue;
+				memcpy(&fltValue, &uBits, sizeof(fltValue));
+				return Number(fltValue);
+			}
+			case 27:
+			{
+				if (!ReadBigEndian(8, uValue))
+					return false;
+
+				double dblValue;
+				memcpy(&dblValue, &uValue, sizeof(dblValue));
+				return Number(dblValue);
+			}
+			default:
+				return Fail(ErrorCode::BadEncoding, pItem); // other simple values and a stray break
+		}
+	}
+
+	// definite text chunks up to a break, written as one string
+	bool CborChunkedString()
+	{
+		m_Out.Put('\"');
+
+		for (;;)
+		{
+			if (m_p >= m_pEnd)
+				return Fail(ErrorCode::UnexpectedEnd, m_p);
+
+			const uint8_t* pChunk = m_p;
+
+			if (*m_p == 0xFF)
+			{
+				m_p++;
+				break;
+			}
+
+			uint64_t uLength = 0;
+
+			if (*m_p >> 5 != 3 || (*m_p & 0x1F) == 31)
+				return Fail(ErrorCode::BadEncoding, pChunk);
+
+			uint8_t uInfo = *m_p++ & 0x1F;
+
+			if (!CborArgument(uInfo, pChunk, uLength))
+				return false;
+
+			if (uLength > (uint64_t)(m_pEnd - m_p))
+				return Fail(ErrorCode::UnexpectedEnd, m_pEnd);
+
+			Escape(m_p, (size_t)uLength);
+			m_p += uLength;
+		}
+
+		m_Out.Put('\"');
+		return true;
+	}
+
+	// uCount is ignored for an indefinite span, which ends at a break instead
+	bool Span(bool bObject, uint64_t uCount, size_t uDepth, bool bKey, const uint8_t* pItem, bool bIndefinite = false)
+	{
+		if (bKey)
+			return Fail(ErrorCode::BadEncoding, pItem);
+
+		if (uDepth >= m_uMaxDepth)
+			return Fail(ErrorCode::TooDeep, pItem);
+
+		m_Out.Put(bObject ? '{' : '[');
+
+		for (uint64_t i = 0; bIndefinite || i < uCount; i++)
+		{
+			if (bIndefinite)
+			{
+				if (m_p >= m_pEnd)
+					return Fail(ErrorCode::UnexpectedEnd, m_p);
+
+				if (*m_p == 0xFF)
+				{
+					m_p++;
+					break;
+				}
+			}
+
+			if (i)
+				m_Out.Put(',');
+
+			if (bObject)
+			{
+				if (!Item(uDepth + 1, true))
+					return false;
+
+				m_Out.Put(':');
+			}
+
+			if (!Item(uDepth + 1, false))
+				return false;
+		}
+
+		m_Out.Put(bObject ? '}' : ']');
+		return true;
+	}
+
+	bool String(uint64_t uLength)
+	{
+		if (uLength > (uint64_t)(m_pEnd - m_p))
+			return Fail(ErrorCode::UnexpectedEnd, m_pEnd);
+
+		m_Out.Put('\"');
+		Escape(m_p, (size_t)uLength);
+		m_Out.Put('\"');
+
+		m_p += uLength;
+		return true;
+	}
+
+	// copies runs that need no escaping as they are
+	void Escape(const uint8_t* p, size_t uLength)
+	{
+		static const char s_szHex[] = "0123456789abcdef";
+		const uint8_t* pEnd = p + uLength;
+		const uint8_t* pRun = p;
+
+		for (; p < pEnd; p++)
+		{
+			uint8_t ch = *p;
+
+			if (ch >= 0x20 && ch != '\"' && ch != '\\')
+				continue;
+
+			m_Out.Write(pRun, p - pRun);
+			pRun = p + 1;
+
+			switch (ch)
+			{
+				case '\"': m_Out.Write("\\\"", 2); break;
+				case '\\': m_Out.Write("\\\\", 2); break;
+				case '\b': m_Out.Write("\\b", 2); break;
+				case '\f': m_Out.Write("\\f", 2); break;
+				case '\n': m_Out.Write("\\n", 2); break;
+				case '\r': m_Out.Write("\\r", 2); break;
+				case '\t': m_Out.Write("\\t", 2); break;
+				default:
+				{
+					char szEscape[6] = { '\\', 'u', '0', '0', s_szHex[ch >> 4], s_szHex[ch & 0xF] };
+					m_Out.Write(szEscape, 6);
+					break;
+				}
+			}
+		}
+
+		m_Out.Write(pRun, p - pRun);
+	}
+
+	bool Integer(bool bNegative, uint64_t uMagnitude, bool bKey)
+	{
+		char szNumber[24];
+		int iLength = snprintf(szNumber, sizeof(szNumber), bNegative ? "-%llu" : "%llu", (unsigned long long)uMagnitude);
+
+		if (bKey)
+			m_Out.Put('\"');
+
+		m_Out.Write(szNumber, (size_t)iLength);
+
+		if (bKey)
+			m_Out.Put('\"');
+
+		return true;
+	}
+
+	// the shortest of two precisions that reads back exactly
+	bool Number(double dblValue)
+	{
+		if (!std::isfinite(dblValue))
+		{
+			m_Out.Write("null", 4);
+			return true;
+		}
+
+		char szNumber[32];
+		int iLength = snprintf(szNumber, sizeof(szNumber), "%.15g", dblValue);
+
+		if (strtod(szNumber, nullptr) != dblValue)
+			iLength = snprintf(szNumber, sizeof(szNumber), "%.17g", dblValue);
+
+		m_Out.Write(szNumber, (size_t)iLength);
+		return true;
+	}
+
+	BinaryFormat m_eFormat;
+	const uint8_t* m_p;
+	const uint8_t* m_pEnd;
+	size_t m_uMaxDepth;
+	SinkBuffer& m_Out;
+};
+
+Result BinaryToJson(BinaryFormat eFormat, const ParserConfig& cfg, const uint8_t* pData, size_t uLength, const SerializeSink& sink, size_t uBufferSize)
+{
+	SinkBuffer out(sink, uBufferSize);
+	BinaryDecoder decoder(eFormat, pData, pData + uLength, cfg.m_uMaxDepth, out);
+
+	Result res;
+
+	if (!decoder.Document())
+	{
+		res.m_bSuccess = false;
+		res.m_eError = decoder.m_eError;
+		res.m_uOffset = (uint64_t)(decoder.m_pError - pData);
+	}
+
+	out.Flush();
+	return res;
+}
+
+Result BinaryToJson(BinaryFormat eFormat, const ParserConfig& cfg, const uint8_t* pData, size_t uLength, utf8string& szOut)
+{
+	szOut.clear();
+	return BinaryToJson(eFormat, cfg, pData, uLength, [&szOut](const utf8_t* pChunk, size_t uSize) { szOut.append(pChunk, uSize); });
+}
+
+}
@@ -0,0 +1,12 @@
+#include "ByteTokenizer.h"
+
+namespace n2ajl
+{
+
+Result Validate(const ParserConfig& cfg, const utf8_t* pBuffer, size_t uLength)
+{
+	NullHandler handler;
+	return Tokenize(cfg, pBuffer, uLength, handler);
+}
+
+}
@@ -0,0 +1,197 @@
+#include <n2ajl/Parser.h>
+#include <n2ajl/Serializer.h>
+#include <n2ajl/Snapshot.h>
+
+#if N2AJL_CXX17
+#include <n2ajl/Embedded.h>
+#endif
+
+#include <cstdio>
+#include <string>
+
+namespace n2ajl
+{
+namespace tests
+{
+
+static size_t s_uFailures = 0;
+
+#define CHECK(expr) { if (!(expr)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); s_uFailures++; } }
+
+static std::string ToJson(const Node& json)
+{
+	SerializerConfig cfg;
+	return Serialize(cfg, json);
+}
+
+static void TestReuseParse()
+{
+	ParserStats stats;
+	ParserConfig cfg;
+	cfg.m_bReuseNodes = true;
+	cfg.m_pStats = &stats;
+
+	Node json;
+	CHECK(Parse(cfg, R"({"name":"pump","on":true,"rpm":[1200,1300],"limits":{"min":1,"max":9}})", json).m_bSuccess);
+
+	// same shape, new values: everything is overwritten in place
+	CHECK(Parse(cfg, R"({"name":"fans","on":false,"rpm":[1250,1350],"limits":{"min":2,"max":8}})", json).m_bSuccess);
+	CHECK(stats.m_uAllocations == 0);
+	CHECK(ToJson(json) == R"({"limits":{"max":8,"min":2},"name":"fans","on":false,"rpm":[1250,1350]})");
+
+	// members and elements that are gone are trimmed, new ones are added
+	CHECK(Parse(cfg, R"({"name":"fans","rpm":[5],"extra":null})", json).m_bSuccess);
+	CHECK(ToJson(json) == R"({"extra":null,"name":"fans","rpm":[5]})");
+
+	// a copy shares the tree, reparsing must not write through to it
+	Node copy = json;
+	CHECK(Parse(cfg, R"({"name":"other","rpm":[6]})", json).m_bSuccess);
+	CHECK(ToJson(copy) == R"({"extra":null,"name":"fans","rpm":[5]})");
+	CHECK(ToJson(json) == R"({"name":"other","rpm":[6]})");
+
+	// no span at all leaves a null root rather than the previous document
+	CHECK(Parse(cfg, " \n\t", json).m_bSuccess);
+	CHECK(json.GetType() == Node::Type::Null);
+}
+
+static void TestParsedHashes()
+{
+	ParserConfig cfg;
+	cfg.m_bComputeHashes = true;
+
+	Node array;
+	CHECK(Parse(cfg, R"([{"a":1},{"a":2}])", array).m_bSuccess);
+	CHECK(array.IsHashed());
+
+	Node object;
+	CHECK(Parse(cfg, R"({"list":[[1,2],[3]],"name":"x"})", object).m_bSuccess);
+	CHECK(object.IsHashed());
+
+	const Node& constObject = object;
+	CHECK(constObject.Get("list")->IsHashed());
+
+	// a read through non-const access drops the hash along the path, the next Hash caches it again
+	uint64_t uHash = object.Hash();
+	object.Get("list")->At(1);
+	CHECK(!object.IsHashed());
+	CHECK(object.Hash() == uHash);
+	CHECK(object.IsHashed());
+
+	// and a write through it is seen by the next Hash
+	*object.Get("list")->At(1)->At(0) = Node(4.0);
+	CHECK(object.Hash() != uHash);
+}
+
+static void TestFrozenHashes()
+{
+	ParserConfig cfg;
+
+	Node json;
+	CHECK(Parse(cfg, R"({"rows":[[1,2],[3,4]],"tags":["a","b"]})", json).m_bSuccess);
+
+	// non-const access before the freeze must not keep any hash from being cached
+	json.Get("rows")->At(0);
+	json.Get("tags");
+
+	Snapshot snapshot = Freeze(json);
+	const Node& root = *snapshot;
+
+	CHECK(root.IsHashed());
+	CHECK(root.Get("rows")->IsHashed());
+	CHECK(root.Get("tags")->IsHashed());
+
+	for (const Node& row : root.Get("rows")->elements())
+		CHECK(row.IsHashed());
+
+	// a separately parsed copy shares no storage, the cached hashes decide it
+	Node again;
+	CHECK(Parse(cfg, R"({"tags":["a","b"],"rows":[[1,2],[3,5]]})", again).m_bSuccess);
+	CHECK(!root.Equals(*Freeze(again)));
+}
+
+static void TestDiffVisits()
+{
+	ParserConfig cfg;
+	cfg.m_bComputeHashes = true;
+
+	std::string szJson = "{";
+	for (int i = 0; i < 100; i++)
+	{
+		szJson += (i ? ",\"m" : "\"m") + std::to_string(i) + "\":[";
+		for (int j = 0; j < 100; j++)
+			szJson += (j ? "," : "") + std::to_string(i * j);
+		szJson += "]";
+	}
+	szJson += "}";
+
+	Node lhs, rhs;
+	CHECK(Parse(cfg, szJson.c_str(), lhs).m_bSuccess);
+	CHECK(Parse(cfg, szJson.c_str(), rhs).m_bSuccess);
+
+	size_t uCalls = 0;
+	auto callback = [&](const utf8string& szPath, const Node* pLHS, const Node* pRHS)
+	{
+		uCalls++;
+		CHECK(szPath == "/m42/7");
+		CHECK(pLHS && pRHS && pLHS->GetNumber() == 294.0 && pRHS->GetNumber() == -1.0);
+	};
+
+	// equal trees that share nothing are told apart by their root hashes alone
+	CHECK(Diff(lhs, rhs, callback) == 0);
+
+	*rhs.Get("m42")->At(7) = Node(-1.0);
+
+	// the root, the changed array and the changed number
+	CHECK(Diff(lhs, rhs, callback) == 3);
+	CHECK(Diff(lhs, rhs, callback, true) == 3);
+	CHECK(uCalls == 2);
+}
+
+#if N2AJL_CXX17
+// the largest double, a tie that rounds to even, the smallest subnormal and a long run of digits
+static constexpr auto s_Numbers = N2AJL_EMBED(R"([1.7976931348623157e308, 1.00000000000000011102230246251565404236316680908203125,
+	4.9406564584124654e-324, 2.2250738585072011e-308, 0.1, 123456789012345678901234567890, 1e-400])");
+
+static_assert(s_Numbers.GetRoot().At(0)->GetNumber() == 1.7976931348623157e308);
+static_assert(s_Numbers.GetRoot().At(1)->GetNumber() == 1.0);
+
+static void TestEmbeddedNumbers()
+{
+	const EmbeddedNode& embedded = s_Numbers.GetRoot();
+
+	Node parsed;
+	CHECK(Parse(ParserConfig(), R"([1.7976931348623157e308, 1.00000000000000011102230246251565404236316680908203125,
+	4.9406564584124654e-324, 2.2250738585072011e-308, 0.1, 123456789012345678901234567890, 1e-400])", parsed).m_bSuccess);
+
+	CHECK(parsed.Length() == embedded.Length());
+
+	for (size_t i = 0; i < parsed.Length() && i < embedded.Length(); i++)
+		CHECK(parsed.At(i)->GetNumber() == embedded.At(i)->GetNumber());
+}
+#endif
+
+}
+}
+
+int main()
+{
+	using namespace n2ajl::tests;
+
+	TestReuseParse();
+	TestParsedHashes();
+	TestFrozenHashes();
+	TestDiffVisits();
+
+#if N2AJL_CXX17
+	TestEmbeddedNumbers();
+#endif
+
+	if (s_uFailures)
+	{
+		printf("%zu checks failed\n", s_uFailures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}